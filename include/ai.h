@@ -0,0 +1,26 @@
+#ifndef PONG_AI_H
+#define PONG_AI_H
+#include <stddef.h>
+#include "game.h"
+#include "batch.h"
+
+typedef struct BallPrediction {
+    float y;        // ball centre when it reaches the target x
+    float ticks;    // whole ticks until then; negative if the ball moves away
+} BallPrediction;
+
+// Where and when the ball reaches target_x, with bounces off the floor and
+// the 600-unit ceiling folded in closed form instead of simulated. Bounces
+// are treated as mirror reflections at radius from the wall, so y can be off
+// by up to one tick of vertical travel per bounce compared to UpdateGame.
+BallPrediction PredictBall(Ball ball, float target_x);
+// Same for n balls stored as arrays; branch-free so the loop vectorizes
+void PredictBallBatch(const float* x, const float* y, const float* vx, const float* vy, size_t n, float radius, float target_x, float* out_y, float* out_ticks);
+
+// Moves the paddle towards where the ball will cross its face, or back to
+// the centre while the ball travels away
+unsigned char AiInput(const GameState* state, int paddle);
+// BatchPolicy driving both paddles of every match with AiInput's rule
+void AiPolicy(const GameBatch* batch, GameInput* inputs, void* user);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef PONG_BATCH_H
+#define PONG_BATCH_H
+#include <stddef.h>
+#include "game.h"
+
+// N matches stored as structure-of-arrays, stepped together with the same
+// semantics as UpdateGame. Ball radius, paddle size and paddle x are the
+// constants InitGameState uses and are not stored per match.
+typedef struct GameBatch {
+    size_t count;
+    size_t capacity;
+
+    float* ball_x;
+    float* ball_y;
+    float* ball_vx;
+    float* ball_vy;
+    float* paddle_y[2];
+    float* paddle_vy[2];
+    unsigned int* score[2];
+    uint64_t* rng; // Rng state of each match
+
+    void* memory; // single aligned block backing every array above
+} GameBatch;
+
+GameBatch CreateGameBatch(size_t capacity);
+void DestroyGameBatch(GameBatch* batch);
+
+// Returns the index of the new match, or (size_t)-1 if the batch is full
+size_t GameBatchAdd(GameBatch* batch, GameState state);
+GameState GameBatchGet(const GameBatch* batch, size_t index);
+void GameBatchSet(GameBatch* batch, size_t index, GameState state);
+// Moves the last match into index; indices past it are unchanged
+void GameBatchRemove(GameBatch* batch, size_t index);
+
+// Tick kernels, selected at runtime from the CPU's features
+typedef enum BatchKernel {
+    BATCH_KERNEL_AUTO,
+    BATCH_KERNEL_SCALAR,
+    BATCH_KERNEL_SSE,   // 4 matches per iteration
+    BATCH_KERNEL_AVX2,  // 8 matches per iteration
+    BATCH_KERNEL_NEON,  // 4 matches per iteration
+} BatchKernel;
+
+int BatchKernelSupported(BatchKernel kernel);
+// Returns 0 and keeps the current kernel if this CPU cannot run the requested one
+int SetBatchKernel(BatchKernel kernel);
+BatchKernel GetBatchKernel();
+const char* BatchKernelName(BatchKernel kernel);
+
+// inputs holds one GameInput per match. StepGameBatch uses the selected
+// kernel; every kernel gives results identical to StepGameBatchScalar.
+void StepGameBatch(GameBatch* batch, const GameInput* inputs);
+void StepGameBatchScalar(GameBatch* batch, const GameInput* inputs);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef PONG_BYTES_H
+#define PONG_BYTES_H
+#include <stdint.h>
+#include <string.h>
+
+// Little-endian encoding for files and packets, independent of the host
+
+static inline void PutU16(unsigned char* p, uint16_t v)
+{
+    p[0] = v; p[1] = v >> 8;
+}
+
+static inline uint16_t GetU16(const unsigned char* p)
+{
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline void PutU32(unsigned char* p, uint32_t v)
+{
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static inline uint32_t GetU32(const unsigned char* p)
+{
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline void PutU64(unsigned char* p, uint64_t v)
+{
+    PutU32(p, (uint32_t)v);
+    PutU32(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline uint64_t GetU64(const unsigned char* p)
+{
+    return GetU32(p) | (uint64_t)GetU32(p + 4) << 32;
+}
+
+static inline uint32_t FloatBits(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static inline float BitsFloat(uint32_t bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef PONG_CLOCK_H
+#define PONG_CLOCK_H
+
+// NTP-style estimate of a remote clock from ping round trips. Each sample
+// gives the remote time at the midpoint of its round trip; the sample with
+// the lowest RTT in the window sets the offset, since queueing only ever
+// adds delay, and successive offsets give the drift between the clocks.
+// Times are in seconds on each side's own clock.
+
+#define CLOCK_SAMPLES 16
+#define CLOCK_MAX_DRIFT 500e-6      // beyond any real crystal; larger estimates are noise
+#define CLOCK_DRIFT_SPAN 8.0        // seconds between offsets used for a drift estimate
+#define CLOCK_MAX_SLEW 0.05         // fastest a slewed clock may run ahead or behind
+#define CLOCK_JUMP 0.5              // seconds of error past which a clock is stepped, not slewed
+
+typedef struct ClockSample {
+    double time;    // local time at the round trip's midpoint
+    double rtt;
+    double offset;  // remote minus local time
+} ClockSample;
+
+typedef struct ClockSync {
+    ClockSample samples[CLOCK_SAMPLES];
+    unsigned int count;
+    unsigned int next;
+    double offset;          // filtered offset at offset_time
+    double offset_time;
+    double drift;           // change of offset per local second
+    double drift_offset;    // filtered offset the next drift estimate is measured from
+    double drift_time;      // below 0 before the first
+    double rtt;             // smoothed, TCP style
+    double rtt_jitter;      // smoothed mean deviation of the RTT
+    double min_rtt;         // in the window: twice the worst offset error it allows
+    double error;           // smoothed distance of new samples from the estimate
+} ClockSync;
+
+void InitClockSync(ClockSync* clock);
+// sent and received are local times of the ping and its reply, remote is
+// the remote clock when it answered
+void AddClockSample(ClockSync* clock, double sent, double remote, double received);
+int ClockSynced(const ClockSync* clock);
+// Remote time at local time, drift corrected
+double RemoteTime(const ClockSync* clock, double local);
+// Amount to add to a local clock that is error seconds behind its target
+// over a frame of dt seconds: at most CLOCK_MAX_SLEW of the frame. Callers
+// step the clock instead once the error passes CLOCK_JUMP.
+double ClockSlew(double error, double dt);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef PONG_FIXED_H
+#define PONG_FIXED_H
+#include <stdint.h>
+#include "game.h"
+
+// Deterministic variant of the simulation: the whole tick runs in 16.16
+// fixed-point integers and ball reflections come from constant tables, so
+// every platform and compiler produces bit-identical states. Follows the
+// same rules as UpdateGame, and consumes the match Rng the same way.
+typedef int32_t Fixed;
+
+#define FIXED_SHIFT 16
+#define FIXED_ONE (1 << FIXED_SHIFT)
+#define INT_TO_FIXED(x) ((Fixed)((x) * FIXED_ONE))
+
+typedef struct FixedBall {
+    Fixed x, y;
+    Fixed vx, vy;
+} FixedBall;
+
+typedef struct FixedPaddle {
+    Fixed y;
+    Fixed vy;
+    unsigned int score;
+} FixedPaddle;
+
+// Ball radius, paddle size and paddle x are the InitGameState constants
+typedef struct FixedGameState {
+    FixedBall ball;
+    FixedPaddle paddles[2];
+    Rng rng;
+} FixedGameState;
+
+FixedBall InitFixedBall(Rng* rng);
+FixedGameState InitFixedGameState(Rng rng);
+void UpdateGameFixed(FixedGameState* state, GameInput input);
+// Event-driven equivalent of calling UpdateGameFixed `ticks` times with the
+// same input: jumps straight to the next wall, paddle or goal event (or the
+// end) whenever every body moves in a straight line, and only steps the
+// ticks where something happens. Returns the number of ticks stepped.
+unsigned long AdvanceGameFixed(FixedGameState* state, GameInput input, unsigned long ticks);
+
+// For rendering and for code written against GameState
+GameState FixedToGameState(const FixedGameState* state);
+// FNV-1a over the state fields, independent of struct layout and endianness
+uint64_t HashFixedGameState(const FixedGameState* state);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef PONG_GAME_H
+#define PONG_GAME_H
+#include "minimath.h"
+#include "rng.h"
+
+typedef struct Ball {
+    MiniVector2 position;
+    float radius;
+
+    MiniVector2 velocity;
+} Ball;
+
+typedef struct Paddle {
+    MiniVector2 position;
+    MiniVector2 size;
+    MiniVector2 velocity;
+    unsigned int score;
+    char score_string[18];  // fits "Score: " and any unsigned int
+} Paddle;
+
+typedef struct GameState {
+    Ball ball;
+    Paddle paddles[2];
+    Rng rng; // serves every ball of this match
+} GameState;
+
+// Buttons held for one paddle during a tick
+enum {
+    INPUT_UP = 1 << 0,
+    INPUT_DOWN = 1 << 1,
+};
+
+typedef struct GameInput {
+    unsigned char paddles[2]; // INPUT_* flags, one entry per paddle
+} GameInput;
+
+Ball InitBall(Rng* rng);
+Paddle InitPaddle(float x, float y);
+GameState InitGameState(Rng rng);
+
+Paddle CheckPaddleCollision(Paddle paddle);
+Ball CheckBallWallCollision(Ball ball);
+Ball CheckBallPaddleCollision(Ball ball, Paddle paddle);
+
+// Continuous collision: returns 1 and the time of impact in [0, 1] if the
+// ball, moving by motion, touches the paddle (circle against box)
+int SweepBallPaddle(Ball ball, MiniVector2 motion, Paddle paddle, float* time);
+
+void NewSet(GameState* state);
+void UpdateGame(GameState* state, GameInput input);
+// Same as UpdateGame, but the ball is swept against walls and paddles with
+// time-of-impact resolution, so fast balls cannot tunnel through paddles
+void UpdateGameSwept(GameState* state, GameInput input);
+
+#endif
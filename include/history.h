@@ -0,0 +1,39 @@
+#ifndef PONG_HISTORY_H
+#define PONG_HISTORY_H
+#include <stdint.h>
+#include "game.h"
+#include "replay.h"
+
+#define HISTORY_SIZE 128 // ticks kept, power of two
+
+// Ring of the last HISTORY_SIZE tick start states and the inputs applied to
+// them. Saving and loading are a fixed-size copy with no allocation; slot
+// i holds tick i % HISTORY_SIZE. Used for rollback, rewind and crash dumps.
+typedef struct GameHistory {
+    GameState states[HISTORY_SIZE];
+    GameInput inputs[HISTORY_SIZE];
+    uint32_t newest;    // last tick saved
+    uint32_t count;     // ticks held, at most HISTORY_SIZE
+} GameHistory;
+
+void InitGameHistory(GameHistory* history);
+// Stores the state tick starts from and its input. Saving a tick that is
+// already held overwrites it and forgets every later tick.
+void SaveGameState(GameHistory* history, uint32_t tick, const GameState* state, GameInput input);
+// Returns 0 if tick is no longer (or not yet) held
+int LoadGameState(const GameHistory* history, uint32_t tick, GameState* state);
+int HasGameState(const GameHistory* history, uint32_t tick);
+// Input recorded for tick; must be held
+GameInput GetHistoryInput(const GameHistory* history, uint32_t tick);
+
+// Largest replay EncodeGameHistory writes: a run per tick, a keyframe per interval
+#define HISTORY_REPLAY_BYTES (REPLAY_HEADER_SIZE + HISTORY_SIZE * 4 + \
+                              (HISTORY_SIZE / REPLAY_DEFAULT_KEYFRAME_INTERVAL + 1) * REPLAY_KEYFRAME_SIZE)
+
+// Encodes the held ticks as a replay starting at the oldest one, so a crash
+// can be reproduced with --replay. Neither allocates nor uses stdio, so a
+// signal handler may call it; out needs HISTORY_REPLAY_BYTES. Returns the
+// size, 0 if no tick is held.
+size_t EncodeGameHistory(const GameHistory* history, unsigned char* out);
+
+#endif
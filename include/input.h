@@ -0,0 +1,45 @@
+#ifndef PONG_INPUT_H
+#define PONG_INPUT_H
+#include <stddef.h>
+#include <stdatomic.h>
+#include "game.h"
+
+typedef struct InputEvent {
+    double time;            // seconds, on the same clock as the tick loop
+    unsigned char paddle;
+    unsigned char button;   // INPUT_UP or INPUT_DOWN
+    unsigned char pressed;  // 1 on press, 0 on release
+} InputEvent;
+
+#define INPUT_QUEUE_SIZE 256 // power of two
+
+// Lock-free single-producer single-consumer ring of input events. The
+// producer (key callback, network thread, bot, replay) pushes, the tick
+// loop pops.
+typedef struct InputQueue {
+    atomic_size_t head; // next slot to read, written by the consumer
+    atomic_size_t tail; // next slot to write, written by the producer
+    InputEvent events[INPUT_QUEUE_SIZE];
+} InputQueue;
+
+// Buttons as seen by the tick loop, plus how long events waited in the queue
+typedef struct InputState {
+    unsigned char held[2];
+    unsigned char tapped[2];    // pressed since the last tick, even if released again
+    double latency_sum;
+    double latency_max;
+    unsigned long latency_count;
+} InputState;
+
+void InitInputQueue(InputQueue* queue);
+// Returns 0 if the queue is full and the event was dropped
+int PushInputEvent(InputQueue* queue, InputEvent event);
+int PeekInputEvent(InputQueue* queue, InputEvent* event);
+int PopInputEvent(InputQueue* queue, InputEvent* event);
+
+// Applies every queued event stamped before tick_end and returns the input
+// for that tick. A press shorter than a tick still counts for one tick.
+// now is the time the tick actually runs, used for the latency statistics.
+GameInput DrainInputQueue(InputQueue* queue, InputState* state, double tick_end, double now);
+
+#endif
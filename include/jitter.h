@@ -0,0 +1,46 @@
+#ifndef PONG_JITTER_H
+#define PONG_JITTER_H
+#include "game.h"
+#include "snapshot.h"
+
+// Client-side playout of server snapshots. Arrivals are timed against the
+// server tick they carry to track the transit time and its jitter; the
+// buffer plays the match that far behind, plus enough delay to cover the
+// jitter and the spacing of the snapshots, so most render frames fall
+// between two received snapshots and are interpolated. Past the newest
+// snapshot it extrapolates for a few ticks, then holds.
+
+#define JITTER_MAX_EXTRAPOLATION 6  // ticks
+#define JITTER_DEVIATIONS 2.0       // jitter estimates of delay on top of the snapshot spacing
+#define JITTER_SLEW 0.05            // max playout speed change while the delay adapts
+
+typedef struct JitterStats {
+    unsigned long received;
+    unsigned long late;         // arrived after its tick had been played
+    unsigned long dropped;      // duplicates, or too old to keep
+    unsigned long interpolated; // samples between two snapshots
+    unsigned long extrapolated;
+    unsigned long held;         // beyond JITTER_MAX_EXTRAPOLATION, or before the oldest snapshot
+} JitterStats;
+
+typedef struct JitterBuffer {
+    SnapshotHistory snapshots;
+    uint32_t newest;        // newest tick received, 0 before any
+    double tick_time;       // seconds per server tick
+    double transit;         // smoothed arrival time minus tick * tick_time
+    double jitter;          // smoothed transit variation between arrivals (RFC 3550)
+    double spacing;         // smoothed ticks between newly received snapshots
+    double offset;          // playout time minus server time, slewed toward the target
+    double last_sample;     // local time of the last sample, below 0 before any
+    JitterStats stats;
+} JitterBuffer;
+
+void InitJitterBuffer(JitterBuffer* buffer, double tick_time);
+void PushJitterSnapshot(JitterBuffer* buffer, const Snapshot* snapshot, double arrival);
+// Delay behind the smoothed transit time the buffer is aiming for
+double JitterBufferDelay(const JitterBuffer* buffer);
+// Samples the match at local time now; the server tick shown, fractional, is
+// written to tick if not NULL. Returns 0 before the first snapshot.
+int SampleJitterBuffer(JitterBuffer* buffer, double now, GameState* state, double* tick);
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef PONG_NET_H
+#define PONG_NET_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "rng.h"
+
+#define NET_MAX_PACKET 512
+#define NET_LINK_QUEUE 1024 // packets held back by a NetLink at once
+
+// IPv4 address and port, both in host byte order
+typedef struct NetAddress {
+    uint32_t host;
+    uint16_t port;
+} NetAddress;
+
+// Non-blocking UDP socket bound to port on every interface (0 picks a free
+// port); returns -1 on error
+int OpenUdpSocket(uint16_t port);
+// Same with SO_REUSEPORT: every socket opened on the port gets a share of
+// the incoming packets, and packets from one sender always reach the same one
+int OpenSharedUdpSocket(uint16_t port);
+void CloseUdpSocket(int socket);
+// Address the socket is bound to, with the host set to loopback
+NetAddress GetLoopbackAddress(int socket);
+// "host:port", where host is a dotted IPv4 address or "localhost"
+int ParseNetAddress(const char* text, NetAddress* address);
+int SendPacket(int socket, const NetAddress* to, const void* data, size_t size);
+// Returns the packet size, 0 if nothing is waiting, -1 on error
+int ReceivePacket(int socket, NetAddress* from, void* data, size_t capacity);
+// Sends the same packet to count addresses, with sendmmsg on Linux, without
+// copying it per receiver. Returns how many were sent before the socket
+// buffer filled or an error stopped it.
+size_t SendPacketToMany(int socket, const NetAddress* to, size_t count, const void* data, size_t size);
+
+// Packet shared by several owners, e.g. threads each fanning it out to
+// their own receivers; the last release frees it
+typedef struct SharedPacket {
+    atomic_uint references;
+    size_t size;
+    unsigned char data[];
+} SharedPacket;
+
+SharedPacket* CreateSharedPacket(const void* data, size_t size, unsigned int references);
+void ReleaseSharedPacket(SharedPacket* packet);
+
+// Simulated network conditions applied to outgoing packets, netem style
+typedef struct NetConditions {
+    double latency;     // seconds added to every packet
+    double jitter;      // extra delay, uniform in [0, jitter]; reorders packets
+    double loss;        // probability of dropping a packet
+} NetConditions;
+
+typedef struct DelayedPacket {
+    double due;
+    NetAddress to;
+    size_t size;
+    unsigned char data[NET_MAX_PACKET];
+} DelayedPacket;
+
+// Sends through a socket after a simulated delay, or drops the packet
+typedef struct NetLink {
+    int socket;
+    NetConditions conditions;
+    Rng rng;
+    DelayedPacket* packets; // NET_LINK_QUEUE slots, in send order
+    size_t count;
+    unsigned long sent;
+    unsigned long dropped;
+} NetLink;
+
+void InitNetLink(NetLink* link, int socket, NetConditions conditions, uint64_t seed);
+void FreeNetLink(NetLink* link);
+// now is on the caller's clock; FlushNetLink must use the same one
+int NetLinkSend(NetLink* link, const NetAddress* to, const void* data, size_t size, double now);
+// Sends every packet whose delay has passed
+void FlushNetLink(NetLink* link, double now);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef PONG_PROTOCOL_H
+#define PONG_PROTOCOL_H
+#include <stddef.h>
+#include <stdint.h>
+#include "snapshot.h"
+
+// Client/server messages for pong-server. Every packet starts with
+// 'P' 'N', the protocol version and the message type; integers are
+// little-endian.
+
+#define PROTOCOL_VERSION 2
+#define PROTOCOL_HEADER_SIZE 4
+
+typedef enum MessageType {
+    MSG_JOIN = 1,   // client asks for a match; resent until the first MSG_STATE
+    MSG_INPUT,      // client's held buttons
+    MSG_STATE,      // server's match state after a tick, sent to each player
+    MSG_LEAVE,      // client quits its match
+    MSG_WATCH,      // spectator subscribes to a match; resent every second to keep watching
+    MSG_PING,       // player asks for the match clock
+    MSG_PONG,       // server's answer, sent at once
+} MessageType;
+
+enum {
+    STATE_FINISHED = 1 << 0, // last state of the match
+};
+
+typedef struct InputMessage {
+    uint32_t match_id;
+    unsigned char paddle;
+    unsigned char buttons;  // INPUT_* flags
+    uint32_t tick;          // client's tick counter when it sent this
+    uint32_t ack;           // newest MSG_STATE tick received, 0 for none
+} InputMessage;
+
+#define SPECTATOR_PADDLE 0xff
+#define SPECTATOR_KEEPALIVE 1.0 // seconds between a spectator's MSG_WATCH
+
+typedef struct StateMessage {
+    uint32_t match_id;
+    unsigned char paddle;   // the receiver's paddle, or SPECTATOR_PADDLE
+    unsigned char flags;    // STATE_* flags
+    uint32_t tick;          // server tick this state ends
+    size_t snapshot_size;
+    unsigned char snapshot[SNAPSHOT_MAX_BYTES]; // EncodeSnapshot output
+} StateMessage;
+
+typedef struct PingMessage {
+    uint32_t match_id;
+    unsigned char paddle;
+    uint64_t client_time;   // opaque to the server, echoed in MSG_PONG
+} PingMessage;
+
+// The match clock: the last tick stepped, plus the time since it was due
+typedef struct PongMessage {
+    uint64_t client_time;
+    uint32_t tick;
+    uint32_t since_tick;    // microseconds
+} PongMessage;
+
+// Returns 0 if data is not a packet of this protocol version
+int ReadMessageType(const unsigned char* data, size_t size, MessageType* type);
+
+// Writers return the packet size; buffer must hold PROTOCOL_MAX_MESSAGE bytes
+#define PROTOCOL_MAX_MESSAGE 64
+size_t WriteJoinMessage(unsigned char* buffer);
+size_t WriteInputMessage(unsigned char* buffer, const InputMessage* message);
+size_t WriteStateMessage(unsigned char* buffer, const StateMessage* message);
+size_t WriteLeaveMessage(unsigned char* buffer, uint32_t match_id, unsigned char paddle);
+size_t WriteWatchMessage(unsigned char* buffer, uint32_t match_id);
+size_t WritePingMessage(unsigned char* buffer, const PingMessage* message);
+size_t WritePongMessage(unsigned char* buffer, const PongMessage* message);
+
+// Readers return 0 on a truncated or mistyped packet
+int ReadInputMessage(const unsigned char* data, size_t size, InputMessage* message);
+int ReadStateMessage(const unsigned char* data, size_t size, StateMessage* message);
+int ReadLeaveMessage(const unsigned char* data, size_t size, uint32_t* match_id, unsigned char* paddle);
+int ReadWatchMessage(const unsigned char* data, size_t size, uint32_t* match_id);
+int ReadPingMessage(const unsigned char* data, size_t size, PingMessage* message);
+int ReadPongMessage(const unsigned char* data, size_t size, PongMessage* message);
+
+#endif
@@ -10,20 +10,73 @@ typedef struct Texture {
 } Texture;
 
 typedef struct Glyph {
-    int codepoint;
+    int codepoint;          // -1 for a free cell
+    int index;              // in the font file
     MiniRecti texture_rect; // in pixels, not normalized
+    MiniRect texture_coords; // the same, normalized
     int xoffset;
     int yoffset;
     float advance;
     int lsb;
 } Glyph;
 
-typedef struct Font {
+typedef struct Color {
+    unsigned char r, g, b, a;
+} Color;
+
+#define COLOR_WHITE ((Color){255, 255, 255, 255})
+
+// Codepoints below this are looked up directly, the rest through a hash table
+#define FONT_INDEX_SIZE 256
+#define FONT_ATLAS_SIZE 512
+#define FONT_DIRTY_RECTS 16     // uploads per flush; past that the last one grows to cover the rest
+
+typedef struct GlyphCacheStats {
+    unsigned long long lookups;
+    unsigned long long hits;
+    unsigned long long rasterized;
+    unsigned long long evicted;
+    unsigned long long dropped;     // no cell left that this frame's text and the TextMeshes do not use
+    unsigned long long uploads;     // dirty rects sent to the texture
+    double raster_seconds;
+    double max_frame_raster;        // seconds, in the worst frame
+} GlyphCacheStats;
+
+typedef struct KernPair {
+    unsigned int glyphs;    // left glyph index << 16 | right, 0xffffffff for an empty slot
+    float advance;          // in pixels
+} KernPair;
+
+// Glyphs are rasterized on first use into fixed-size cells of the atlas,
+// and only the cells that changed are uploaded. With every cell taken, the
+// least recently used one is reused, unless text of the current frame uses
+// it or a TextMesh pins it.
+typedef struct GlyphCache {
     stbtt_fontinfo info;
-    Texture texture;
-    Glyph* glyphs;
+    unsigned char* data;        // the font file, freed with the font if set
+    int cell_width, cell_height;
+    int columns;
+    Glyph* glyphs;              // one per cell
     size_t glyphs_num;
+    unsigned long* last_used;   // frame of the last lookup
+    unsigned int* pins;         // TextMeshes showing the cell
+    short direct[FONT_INDEX_SIZE]; // cell, -1 for none
+    int* table;                 // cells of the other codepoints, open addressing, -1 for empty
+    size_t table_mask;
+    KernPair* kerning;          // the font's kern pairs, read at load, open addressing; NULL without a kern table
+    size_t kerning_mask;
+    unsigned char* pixels;      // coverage, mirrored into the atlas
+    MiniRecti dirty[FONT_DIRTY_RECTS];
+    size_t dirty_count;
+    unsigned long frame;
+    double frame_raster;
+    GlyphCacheStats stats;
+} GlyphCache;
+
+typedef struct Font {
+    Texture texture;
     float scale;
+    GlyphCache* cache;
 } Font;
 
 // Shaders
@@ -40,10 +93,82 @@ void UnloadTexture(Texture texture);
 
 // Fonts/Text
 Font LoadFontFromFile(const char* path, int size);
+// data must outlive the font, which rasterizes glyphs from it as they are needed
 Font LoadFontFromMemory(unsigned char* data, int size);
 void UnloadFont(Font font);
+const GlyphCacheStats* GetGlyphCacheStats(Font font);
+// Queues the string's glyphs for the text batch, drawn at EndSpriteBatch;
+// text is UTF-8
 void DrawText(Font font, const char* text, float x, float y);
 
+// Text laid out once into a GPU buffer of its own, and laid out again only
+// when SetTextMesh gets another font or string: for HUD text that rarely
+// changes, which then costs one draw and no layout per frame. The font's
+// cache keeps the glyphs it shows pinned.
+typedef struct TextMesh {
+    unsigned int vao, instances;
+    unsigned int texture;   // the font's atlas
+    GlyphCache* cache;      // with text, the key of the layout
+    char* text;
+    short* cells;           // the glyph of each instance
+    size_t count;
+    size_t capacity;        // glyphs the instance buffer holds
+} TextMesh;
+
+void InitTextMesh(TextMesh* mesh);
+// Returns 1 if the text had to be laid out
+int SetTextMesh(TextMesh* mesh, Font font, const char* text);
+// Queued like DrawText; x, y is where the baseline starts
+void DrawTextMesh(const TextMesh* mesh, float x, float y);
+// Before its font is unloaded
+void FreeTextMesh(TextMesh* mesh);
+
 void SetProjViewMatrix(MiniMatrix mat);
 
+// Sprite batch: every quad of a frame goes into one streaming vertex buffer
+// and is drawn with as few glDrawElements as possible. A batch only breaks
+// when it fills up, on a texture change, or when SetSpriteProgram changes
+// the program; untextured shapes never break one.
+#define SPRITE_BATCH_QUADS 4096
+
+typedef enum SpriteShape {
+    SPRITE_RECTANGLE,
+    SPRITE_CIRCLE,
+    SPRITE_TEXTURED,
+} SpriteShape;
+
+// Glyphs go to a text batch of their own instead: one instance record per
+// glyph, and one glDrawArraysInstanced for every string of the frame that
+// uses the same font. It is drawn after the sprites, so text is on top.
+#define TEXT_BATCH_GLYPHS 4096
+#define TEXT_MESH_DRAWS 256     // TextMesh draws queued per flush
+
+typedef struct SpriteBatchStats {
+    unsigned long frames;
+    unsigned long long draw_calls;  // sprites and text
+    unsigned long long vertices;
+    unsigned long long glyphs;
+    unsigned long long layouts;     // strings laid out, by DrawText or SetTextMesh
+    unsigned int frame_draw_calls;  // last frame
+    unsigned int frame_vertices;
+    unsigned int frame_glyphs;
+    unsigned int max_draw_calls;
+} SpriteBatchStats;
+
+// program and text_program must take the attributes of
+// res/shaders/sprite.vert and res/shaders/text.vert
+int InitSpriteBatch(unsigned int program, unsigned int text_program);
+void FreeSpriteBatch();
+// time drives the rectangles' wobble
+void BeginSpriteBatch(float time);
+// Draws the sprites, then the text
+void EndSpriteBatch();
+void SetSpriteProgram(unsigned int program);
+// wobble shakes the rectangle sideways, by up to half of it either way
+void DrawRectangle(MiniRect rect, Color color, float wobble);
+void DrawCircle(MiniVector2 center, float radius, Color color);
+// source is in pixels, not normalized; the texture is multiplied by tint
+void DrawTexture(Texture texture, MiniRect source, MiniRect dest, Color tint);
+const SpriteBatchStats* GetSpriteBatchStats();
+
 #endif
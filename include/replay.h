@@ -0,0 +1,82 @@
+#ifndef PONG_REPLAY_H
+#define PONG_REPLAY_H
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+#include "fixed.h"
+
+// Replay file, all integers little-endian:
+//   header     64 bytes: magic, version, flags, seed, tick/keyframe/run counts, offsets
+//   runs       4 bytes each: both paddles' input (4 bits) | run length << 4
+//   keyframes  64 bytes each: tick, position in the runs, full match state
+// A keyframe is written every keyframe_interval ticks, starting at tick 0, so
+// seeking is one index computation plus fewer than keyframe_interval ticks
+// of simulation. Float replays store raw IEEE bits and re-simulate exactly
+// only with the same build; fixed-point replays are portable.
+
+#define REPLAY_VERSION 1
+#define REPLAY_FIXED 1 // flag: recorded with the fixed-point simulation
+#define REPLAY_DEFAULT_KEYFRAME_INTERVAL 300
+#define REPLAY_HEADER_SIZE 64
+#define REPLAY_KEYFRAME_SIZE 64
+
+typedef struct ReplayWriter {
+    uint32_t flags;
+    uint64_t seed;
+    uint32_t keyframe_interval;
+    uint32_t ticks;
+
+    uint32_t* runs;
+    size_t run_count, run_capacity;
+    unsigned char* keyframes;
+    size_t keyframe_count, keyframe_capacity;
+} ReplayWriter;
+
+typedef struct Replay {
+    const unsigned char* data;
+    size_t size;
+    int mapped;
+
+    uint32_t flags;
+    uint64_t seed;
+    uint32_t ticks;
+    uint32_t keyframe_interval;
+    uint32_t keyframe_count;
+    uint32_t run_count;
+    const unsigned char* runs;
+    const unsigned char* keyframes;
+} Replay;
+
+// Playback position: the next tick to simulate and where its input is stored
+typedef struct ReplayCursor {
+    uint32_t tick;
+    uint32_t run;
+    uint32_t run_offset;
+} ReplayCursor;
+
+void InitReplayWriter(ReplayWriter* writer, Rng seed, uint32_t keyframe_interval, int fixed);
+// Records into the caller's storage, which must hold every run and keyframe
+// of the recording, so the writer never allocates; skip FreeReplayWriter
+void InitReplayWriterInto(ReplayWriter* writer, Rng seed, uint32_t keyframe_interval, int fixed,
+                          uint32_t* runs, size_t run_capacity, unsigned char* keyframes, size_t keyframe_capacity);
+// Call before every tick with the state the tick starts from and its input
+void RecordReplayTick(ReplayWriter* writer, const GameState* state, GameInput input);
+void RecordReplayTickFixed(ReplayWriter* writer, const FixedGameState* state, GameInput input);
+int SaveReplay(const ReplayWriter* writer, const char* path);
+// The file's bytes in memory, with no allocation or stdio; out must hold
+// ReplayFileSize bytes. Returns the size written.
+size_t ReplayFileSize(const ReplayWriter* writer);
+size_t EncodeReplay(const ReplayWriter* writer, unsigned char* out);
+void FreeReplayWriter(ReplayWriter* writer);
+
+// Maps the file read-only; returns 0 on error
+int OpenReplay(Replay* replay, const char* path);
+void CloseReplay(Replay* replay);
+
+// Jump to the nearest keyframe at or before tick and re-simulate up to it
+int SeekReplay(const Replay* replay, uint32_t tick, GameState* state, ReplayCursor* cursor);
+int SeekReplayFixed(const Replay* replay, uint32_t tick, FixedGameState* state, ReplayCursor* cursor);
+// Input of the tick at the cursor, advancing it; returns 0 at the end
+int NextReplayInput(const Replay* replay, ReplayCursor* cursor, GameInput* input);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef PONG_RNG_H
+#define PONG_RNG_H
+#include <stdint.h>
+
+// PCG32 (XSH-RR) generator. Every match owns one, so matches can be stepped
+// in parallel and reproduced from their seed. All generators share a single
+// stream; independent matches take disjoint slices of it via jump-ahead.
+typedef struct Rng {
+    uint64_t state;
+} Rng;
+
+// Precomputed affine step that advances a generator by a fixed number of draws
+typedef struct RngJump {
+    uint64_t mult;
+    uint64_t plus;
+} RngJump;
+
+// Draws reserved for each match before it would overlap the next one
+#define MATCH_RNG_SPACING (1ULL << 32)
+
+Rng SeedRng(uint64_t seed);
+uint32_t RngNext(Rng* rng);
+// Uniform in [0, bound), without modulo bias
+uint32_t RngBounded(Rng* rng, uint32_t bound);
+
+RngJump MakeRngJump(uint64_t delta);
+void RngJumpAhead(Rng* rng, RngJump jump);
+// O(log delta); for many jumps of the same size, use MakeRngJump once
+void RngAdvance(Rng* rng, uint64_t delta);
+
+// Generator of match number `match` in a run seeded with root_seed
+Rng MatchRng(uint64_t root_seed, uint64_t match);
+
+#endif
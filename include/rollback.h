@@ -0,0 +1,59 @@
+#ifndef PONG_ROLLBACK_H
+#define PONG_ROLLBACK_H
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+#include "history.h"
+
+// GGPO-style rollback for two peers each driving one paddle. Every tick
+// runs at once with the remote paddle's input predicted (its last known
+// input). When the real input arrives and differs, the session restores the
+// state of the mispredicted tick from its GameHistory and re-simulates up to
+// the present before the next tick. Both peers must run the same build and
+// start from the same GameState.
+
+#define ROLLBACK_MAX_INPUTS 64      // inputs per packet
+#define ROLLBACK_MAX_PREDICTION 32  // upper bound for max_prediction
+
+typedef struct RollbackStats {
+    unsigned long rollbacks;
+    unsigned long long resimulated;  // ticks simulated again after a rollback
+    uint32_t max_depth;              // longest rollback, in ticks
+    unsigned long stalls;            // ticks delayed waiting for the remote peer
+} RollbackStats;
+
+typedef struct RollbackSession {
+    int local_paddle;
+    uint32_t input_delay;       // local inputs apply this many ticks after they are read
+    uint32_t max_prediction;    // ticks we may run ahead of the remote's confirmed input
+
+    uint32_t tick;              // next tick to simulate
+    GameState state;            // state at the start of tick
+    GameHistory history;
+
+    unsigned char local_inputs[HISTORY_SIZE];   // by tick
+    uint32_t local_count;                       // local inputs known for ticks [0, local_count)
+    unsigned char remote_inputs[HISTORY_SIZE];  // confirmed remote input, by tick
+    uint32_t remote_ticks[HISTORY_SIZE];        // tick + 1 each slot holds, 0 if empty
+    unsigned char predicted[HISTORY_SIZE];      // remote input a simulated tick used
+    uint32_t remote_confirmed;  // every remote input before this tick has arrived
+    uint32_t remote_ack;        // the remote has every local input before this tick
+    uint32_t rollback_tick;     // earliest mispredicted tick, or UINT32_MAX
+
+    RollbackStats stats;
+} RollbackSession;
+
+void InitRollbackSession(RollbackSession* session, GameState initial, int local_paddle, uint32_t input_delay, uint32_t max_prediction);
+// Queues the local input for tick + input_delay. Returns 0 and drops the
+// input while the session is stalled and already has enough of them.
+int AddLocalInput(RollbackSession* session, unsigned char input);
+// Every local input the remote has not acknowledged, plus our own ack.
+// Returns the packet size.
+size_t WriteRollbackPacket(const RollbackSession* session, unsigned char* buffer, size_t capacity);
+// Returns 0 if the packet is malformed
+int ReadRollbackPacket(RollbackSession* session, const unsigned char* data, size_t size);
+// Re-simulates from the earliest misprediction if needed, then runs one
+// tick. Returns 0 if it stalled: no local input yet, or too far ahead.
+int AdvanceRollback(RollbackSession* session);
+
+#endif
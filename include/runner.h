@@ -0,0 +1,42 @@
+#ifndef PONG_RUNNER_H
+#define PONG_RUNNER_H
+#include <stddef.h>
+#include "batch.h"
+
+// Fills inputs[i] for every match of the batch before each tick
+typedef void (*BatchPolicy)(const GameBatch* batch, GameInput* inputs, void* user);
+
+typedef struct RunnerOptions {
+    unsigned long matches;
+    unsigned int points;        // a match stops when one side reaches this score
+    unsigned long max_ticks;    // ... or after this many ticks
+    uint64_t seed;
+    unsigned int threads;       // 0 uses every online core
+    size_t chunk_size;          // matches stepped together as one GameBatch
+    BatchPolicy policy;
+    void* policy_user;
+} RunnerOptions;
+
+typedef struct RunnerThreadStats {
+    unsigned long long ticks;
+    unsigned long tasks;
+    unsigned long steals;
+    double busy_seconds;        // CPU time spent stepping matches
+} RunnerThreadStats;
+
+typedef struct RunnerResult {
+    unsigned long long ticks;
+    unsigned long wins[2];
+    double seconds;
+    unsigned int threads;
+    RunnerThreadStats* thread_stats; // one entry per thread
+} RunnerResult;
+
+// Spreads the matches over a pool of worker threads. Each worker owns a
+// deque of match ranges: it splits its range in half until it is one chunk,
+// keeping the halves at the bottom of its deque, and idle workers steal
+// from the top of other deques, or sleep until more work is pushed.
+RunnerResult RunMatches(RunnerOptions options);
+void FreeRunnerResult(RunnerResult* result);
+
+#endif
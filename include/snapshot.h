@@ -0,0 +1,54 @@
+#ifndef PONG_SNAPSHOT_H
+#define PONG_SNAPSHOT_H
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+
+// Quantized match state for the network. Positions are kept to a quarter
+// of a court unit, which is enough to interpolate smoothly at 800x600, and
+// velocities to 1/64 of a unit per tick. The score strings, sizes and Rng
+// are not sent: clients rebuild them from the constants.
+
+#define SNAPSHOT_POSITION_SCALE 4
+#define SNAPSHOT_VELOCITY_SCALE 64
+#define SNAPSHOT_MAX_BYTES 32   // any encoding with a baseline under 65536 ticks back
+
+typedef struct Snapshot {
+    uint32_t tick;
+    int16_t ball_x, ball_y;
+    int16_t ball_vx, ball_vy;
+    int16_t paddle_y[2];
+    int16_t paddle_vy[2];
+    uint16_t score[2];
+} Snapshot;
+
+Snapshot QuantizeGameState(const GameState* state, uint32_t tick);
+GameState DequantizeSnapshot(const Snapshot* snapshot);
+
+// Bit-packs snapshot as a delta against baseline, an earlier snapshot the
+// receiver acknowledged, or in full if baseline is NULL. Positions are
+// predicted from the baseline's velocity, so a tick without bounces, hits or
+// input changes takes 2 bytes. The snapshot's tick is not written; the
+// caller sends it. Returns the size, or 0 if capacity is too small.
+size_t EncodeSnapshot(const Snapshot* snapshot, const Snapshot* baseline, unsigned char* buffer, size_t capacity);
+// Ticks from the baseline to the encoded snapshot, 0 for a full snapshot.
+// Tells the receiver which stored snapshot to pass to DecodeSnapshot.
+int ReadSnapshotBaseline(const unsigned char* data, size_t size, uint32_t* distance);
+// baseline must be the snapshot tick - distance, or NULL for a full one
+int DecodeSnapshot(const unsigned char* data, size_t size, uint32_t tick, const Snapshot* baseline, Snapshot* snapshot);
+
+// Recent snapshots by tick: sender side for the baselines clients may
+// acknowledge, receiver side for the baselines senders may use
+#define SNAPSHOT_HISTORY 32 // power of two
+
+typedef struct SnapshotHistory {
+    Snapshot snapshots[SNAPSHOT_HISTORY];
+    unsigned char valid[SNAPSHOT_HISTORY];
+} SnapshotHistory;
+
+void InitSnapshotHistory(SnapshotHistory* history);
+void StoreSnapshot(SnapshotHistory* history, const Snapshot* snapshot);
+// NULL if that tick was never stored or has been overwritten
+const Snapshot* FindSnapshot(const SnapshotHistory* history, uint32_t tick);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef PONG_TIMER_H
+#define PONG_TIMER_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Hierarchical timer wheel: TIMER_LEVELS wheels of TIMER_SLOTS slots, each
+// level TIMER_SLOTS times coarser than the one below. Time is an integer
+// count of units chosen by the caller. Scheduling and cancelling are O(1);
+// advancing costs one slot visit per unit plus one cascade per TIMER_SLOTS
+// units, however many timers are pending. Timers are numbered 0..capacity-1
+// so owners can refer to them by a stable index.
+
+#define TIMER_BITS 8
+#define TIMER_SLOTS (1 << TIMER_BITS)
+#define TIMER_LEVELS 4
+#define TIMER_NONE UINT32_MAX
+
+typedef struct TimerEntry {
+    uint64_t due;
+    uint32_t next;
+    uint32_t prev;
+    uint32_t slot;      // index into TimerWheel.slots, TIMER_NONE when idle
+} TimerEntry;
+
+typedef struct TimerWheel {
+    uint64_t now;
+    uint32_t slots[TIMER_LEVELS * TIMER_SLOTS]; // list heads
+    TimerEntry* timers;
+    size_t capacity;
+} TimerWheel;
+
+// Called for each expired timer; it may schedule or cancel any timer
+typedef void (*TimerCallback)(TimerWheel* wheel, uint32_t timer, uint64_t due, void* user);
+
+TimerWheel CreateTimerWheel(size_t capacity, uint64_t now);
+void DestroyTimerWheel(TimerWheel* wheel);
+// Reschedules the timer if it is already pending. A due time that has
+// passed fires on the next unit.
+void ScheduleTimer(TimerWheel* wheel, uint32_t timer, uint64_t due);
+void CancelTimer(TimerWheel* wheel, uint32_t timer);
+int TimerPending(const TimerWheel* wheel, uint32_t timer);
+// Fires every timer due up to now, in order of due time (to the unit)
+void AdvanceTimerWheel(TimerWheel* wheel, uint64_t now, TimerCallback callback, void* user);
+
+// How late timers fired: log2 buckets from 50 us up to 51.2 ms and beyond
+#define LATENESS_BUCKETS 12
+
+typedef struct LatenessHistogram {
+    unsigned long long counts[LATENESS_BUCKETS];
+    unsigned long long total;
+    double sum;
+    double max;
+} LatenessHistogram;
+
+void RecordLateness(LatenessHistogram* histogram, double seconds);
+void MergeLatenessHistogram(LatenessHistogram* into, const LatenessHistogram* from);
+// Upper bound of the bucket holding the p-th fraction of samples
+double LatenessPercentile(const LatenessHistogram* histogram, double p);
+void PrintLatenessHistogram(const LatenessHistogram* histogram, FILE* file);
+
+#endif
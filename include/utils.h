@@ -4,6 +4,9 @@
 #include <stdlib.h>
 
 unsigned char* ReadFile(const char* path);
+// Decodes the UTF-8 sequence at *text and moves past it; a malformed byte
+// decodes to U+FFFD on its own
+int DecodeUtf8(const char** text);
 // float deg2rad(float deg);
 
 #endif
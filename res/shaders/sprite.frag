@@ -0,0 +1,30 @@
+#version 330 core
+
+// fShape.x is the SPRITE_* shape from render.h, fShape.y the rectangle's wobble
+
+uniform sampler2D texture0;
+uniform float time;
+
+in vec2 fPosition;
+in vec2 fTextureCoords;
+in vec4 fColor;
+flat in vec4 fRect;
+flat in vec2 fShape;
+
+out vec4 fragColor;
+
+void main()
+{
+    int shape = int(fShape.x + 0.5);
+    if (shape == 1) {
+        vec2 center = fRect.xy + fRect.zw * 0.5;
+        if (distance(fPosition, center) > fRect.z * 0.5) discard;
+        fragColor = fColor;
+    } else if (shape == 2) {
+        fragColor = fColor * texture(texture0, fTextureCoords);
+    } else {
+        float wave = fShape.y * 0.5 * sin(2.0 * 3.14 * 10.0 * fPosition.y + time);
+        if (fPosition.x < fRect.x + wave || fPosition.x > fRect.x + fRect.z + wave) discard;
+        fragColor = fColor;
+    }
+}
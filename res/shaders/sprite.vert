@@ -0,0 +1,25 @@
+#version 330 core
+
+layout(location = 0) in vec2 vPosition;
+layout(location = 1) in vec2 vTextureCoords;
+layout(location = 2) in vec4 vColor;
+layout(location = 3) in vec4 vRect;
+layout(location = 4) in vec2 vShape;
+
+uniform mat4 projview;
+
+out vec2 fPosition;
+out vec2 fTextureCoords;
+out vec4 fColor;
+flat out vec4 fRect;
+flat out vec2 fShape;
+
+void main()
+{
+    gl_Position = projview * vec4(vPosition, 0.0, 1.0);
+    fPosition = vPosition;
+    fTextureCoords = vTextureCoords;
+    fColor = vColor;
+    fRect = vRect;
+    fShape = vShape;
+}
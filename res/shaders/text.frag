@@ -3,9 +3,11 @@
 uniform sampler2D texture0;
 
 in vec2 fTextureCoords;
+in vec4 fColor;
+
 out vec4 fragColor;
 
 void main()
 {
-    fragColor = texture(texture0, fTextureCoords);
+    fragColor = fColor * texture(texture0, fTextureCoords);
 }
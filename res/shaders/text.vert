@@ -0,0 +1,20 @@
+#version 330 core
+
+layout(location = 0) in vec2 vCorner;
+// per glyph: screen rect in pixels, atlas rect normalized
+layout(location = 1) in vec4 vRect;
+layout(location = 2) in vec4 vSource;
+layout(location = 3) in vec4 vColor;
+
+uniform mat4 projview;
+uniform vec2 offset;   // where a TextMesh is drawn
+
+out vec2 fTextureCoords;
+out vec4 fColor;
+
+void main()
+{
+    gl_Position = projview * vec4(offset + vRect.xy + vCorner * vRect.zw, 0.0, 1.0);
+    fTextureCoords = vSource.xy + vCorner * vSource.zw;
+    fColor = vColor;
+}
@@ -0,0 +1,75 @@
+#include "ai.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define COURT_HEIGHT 600.f
+#define AI_BATCH_BLOCK 256
+
+// x of the face each paddle defends, from the InitGameState layout
+static const float paddle_face[2] = {10.f, 790.f};
+
+// Folds an unbounded y back into [radius, 600 - radius] like a light ray
+// between two mirrors: a triangle wave with period twice the free height
+static inline float FoldY(float y, float radius)
+{
+    float span = COURT_HEIGHT - 2.f * radius;
+    float u = y - radius;
+    float m = u - 2.f * span * floorf(u / (2.f * span));
+    return radius + span - fabsf(m - span);
+}
+
+BallPrediction PredictBall(Ball ball, float target_x)
+{
+    BallPrediction prediction;
+    float ticks = ball.velocity.x != 0.f ? ceilf((target_x - ball.position.x) / ball.velocity.x) : -1.f;
+    prediction.ticks = ticks;
+    prediction.y = FoldY(ball.position.y + (ticks > 0.f ? ticks : 0.f) * ball.velocity.y, ball.radius);
+    return prediction;
+}
+
+void PredictBallBatch(const float* x, const float* y, const float* vx, const float* vy, size_t n, float radius, float target_x, float* out_y, float* out_ticks)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        // vx is never 0 in play: serves and bounces keep |vx| >= 7
+        float ticks = ceilf((target_x - x[i]) / vx[i]);
+        out_ticks[i] = ticks;
+        out_y[i] = FoldY(y[i] + fmaxf(ticks, 0.f) * vy[i], radius);
+    }
+}
+
+static inline unsigned char SteerPaddle(float paddle_center, float target)
+{
+    // Dead zone of one paddle step so the paddle does not oscillate
+    if (target > paddle_center + 10.f) return INPUT_UP;
+    if (target < paddle_center - 10.f) return INPUT_DOWN;
+    return 0;
+}
+
+unsigned char AiInput(const GameState* state, int paddle)
+{
+    const Paddle* p = &state->paddles[paddle];
+    BallPrediction prediction = PredictBall(state->ball, paddle_face[paddle]);
+    float target = prediction.ticks >= 0.f ? prediction.y : COURT_HEIGHT / 2.f;
+    return SteerPaddle(p->position.y + p->size.y / 2.f, target);
+}
+
+void AiPolicy(const GameBatch* batch, GameInput* inputs, void* user)
+{
+    float predicted_y[AI_BATCH_BLOCK];
+    float predicted_ticks[AI_BATCH_BLOCK];
+
+    for (size_t begin = 0; begin < batch->count; begin += AI_BATCH_BLOCK)
+    {
+        size_t n = batch->count - begin < AI_BATCH_BLOCK ? batch->count - begin : AI_BATCH_BLOCK;
+        for (int p = 0; p < 2; p++)
+        {
+            PredictBallBatch(batch->ball_x + begin, batch->ball_y + begin, batch->ball_vx + begin, batch->ball_vy + begin, n, 5.f, paddle_face[p], predicted_y, predicted_ticks);
+            for (size_t i = 0; i < n; i++)
+            {
+                float target = predicted_ticks[i] >= 0.f ? predicted_y[i] : COURT_HEIGHT / 2.f;
+                inputs[begin + i].paddles[p] = SteerPaddle(batch->paddle_y[p][begin + i] + 50.f, target);
+            }
+        }
+    }
+}
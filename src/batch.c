@@ -0,0 +1,512 @@
+#include "batch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define BATCH_ALIGNMENT 32
+#define BATCH_ARRAYS 10 // 32-bit arrays; the rng array takes two more strides
+
+static const float ball_radius = 5.f;
+static const MiniVector2 paddle_size = {20.f, 100.f};
+static const float paddle_x[2] = {-10.f, 790.f};
+
+GameBatch CreateGameBatch(size_t capacity)
+{
+    GameBatch batch;
+    memset(&batch, 0, sizeof(batch));
+
+    // Round every array up to whole 32-byte blocks so each one starts aligned
+    size_t stride = (capacity * sizeof(float) + BATCH_ALIGNMENT - 1) / BATCH_ALIGNMENT * BATCH_ALIGNMENT;
+    if (stride == 0) stride = BATCH_ALIGNMENT;
+    size_t size = stride * (BATCH_ARRAYS + 2);
+    unsigned char* memory = (unsigned char*)aligned_alloc(BATCH_ALIGNMENT, size);
+    if (memory == NULL) {
+        fprintf(stderr, "Failed to allocate batch of %zu matches\n", capacity);
+        return batch;
+    }
+    memset(memory, 0, size);
+
+    batch.capacity = capacity;
+    batch.memory = memory;
+    batch.ball_x = (float*)(memory + 0 * stride);
+    batch.ball_y = (float*)(memory + 1 * stride);
+    batch.ball_vx = (float*)(memory + 2 * stride);
+    batch.ball_vy = (float*)(memory + 3 * stride);
+    batch.paddle_y[0] = (float*)(memory + 4 * stride);
+    batch.paddle_y[1] = (float*)(memory + 5 * stride);
+    batch.paddle_vy[0] = (float*)(memory + 6 * stride);
+    batch.paddle_vy[1] = (float*)(memory + 7 * stride);
+    batch.score[0] = (unsigned int*)(memory + 8 * stride);
+    batch.score[1] = (unsigned int*)(memory + 9 * stride);
+    batch.rng = (uint64_t*)(memory + 10 * stride);
+
+    return batch;
+}
+
+void DestroyGameBatch(GameBatch* batch)
+{
+    free(batch->memory);
+    memset(batch, 0, sizeof(*batch));
+}
+
+void GameBatchSet(GameBatch* batch, size_t index, GameState state)
+{
+    batch->ball_x[index] = state.ball.position.x;
+    batch->ball_y[index] = state.ball.position.y;
+    batch->ball_vx[index] = state.ball.velocity.x;
+    batch->ball_vy[index] = state.ball.velocity.y;
+    for (int p = 0; p < 2; p++)
+    {
+        batch->paddle_y[p][index] = state.paddles[p].position.y;
+        batch->paddle_vy[p][index] = state.paddles[p].velocity.y;
+        batch->score[p][index] = state.paddles[p].score;
+    }
+    batch->rng[index] = state.rng.state;
+}
+
+size_t GameBatchAdd(GameBatch* batch, GameState state)
+{
+    if (batch->count >= batch->capacity) return (size_t)-1;
+
+    size_t index = batch->count++;
+    GameBatchSet(batch, index, state);
+    return index;
+}
+
+GameState GameBatchGet(const GameBatch* batch, size_t index)
+{
+    GameState state;
+    state.ball.position = (MiniVector2){batch->ball_x[index], batch->ball_y[index]};
+    state.ball.radius = ball_radius;
+    state.ball.velocity = (MiniVector2){batch->ball_vx[index], batch->ball_vy[index]};
+    for (int p = 0; p < 2; p++)
+    {
+        state.paddles[p] = InitPaddle(paddle_x[p], batch->paddle_y[p][index]);
+        state.paddles[p].velocity.y = batch->paddle_vy[p][index];
+        state.paddles[p].score = batch->score[p][index];
+        snprintf(state.paddles[p].score_string, sizeof(state.paddles[p].score_string), "Score: %u", state.paddles[p].score);
+    }
+    state.rng.state = batch->rng[index];
+
+    return state;
+}
+
+void GameBatchRemove(GameBatch* batch, size_t index)
+{
+    size_t last = --batch->count;
+    if (index == last) return;
+
+    batch->ball_x[index] = batch->ball_x[last];
+    batch->ball_y[index] = batch->ball_y[last];
+    batch->ball_vx[index] = batch->ball_vx[last];
+    batch->ball_vy[index] = batch->ball_vy[last];
+    for (int p = 0; p < 2; p++)
+    {
+        batch->paddle_y[p][index] = batch->paddle_y[p][last];
+        batch->paddle_vy[p][index] = batch->paddle_vy[p][last];
+        batch->score[p][index] = batch->score[p][last];
+    }
+    batch->rng[index] = batch->rng[last];
+}
+
+// Same as NewSet: serve a new ball and recentre the paddles, keeping their velocity
+static void ServeBatchMatch(GameBatch* batch, size_t i)
+{
+    Rng rng = {batch->rng[i]};
+    Ball ball = InitBall(&rng);
+    batch->rng[i] = rng.state;
+    batch->ball_x[i] = ball.position.x;
+    batch->ball_y[i] = ball.position.y;
+    batch->ball_vx[i] = ball.velocity.x;
+    batch->ball_vy[i] = ball.velocity.y;
+    batch->paddle_y[0][i] = 300.f;
+    batch->paddle_y[1][i] = 300.f;
+}
+
+// Ball against paddles (CheckBallPaddleCollision) and scoring for one match.
+// Both are rare, so every kernel handles them here as branchy scalar code.
+static void ResolveBatchMatch(GameBatch* batch, size_t i)
+{
+    float x = batch->ball_x[i];
+    float y = batch->ball_y[i];
+    for (int p = 0; p < 2; p++)
+    {
+        float py = batch->paddle_y[p][i];
+        if (x > paddle_x[p] && x < paddle_x[p] + paddle_size.x && y > py && y < py + paddle_size.y) {
+            float distanceToCenter = y - (py + paddle_size.y / 2);
+            float angle = distanceToCenter / 50.f * M_PI / 4.f;
+            if (batch->ball_vx[i] < 0) {
+                batch->ball_vx[i] = cos(angle) * 10.f;
+            } else {
+                batch->ball_vx[i] = -cos(angle) * 10.f;
+            }
+            batch->ball_vy[i] = sin(angle) * 10.f;
+        }
+    }
+
+    if (x < 0) {
+        batch->score[1][i]++;
+        ServeBatchMatch(batch, i);
+    } else if (x > 800.f) {
+        batch->score[0][i]++;
+        ServeBatchMatch(batch, i);
+    }
+}
+
+// Reference kernel for matches [begin, end); the SIMD kernels must match it bit for bit
+static void StepGameBatchRange(GameBatch* batch, const GameInput* inputs, size_t begin, size_t end)
+{
+    // Paddles: input, movement and wall clamp (CheckPaddleCollision)
+    for (int p = 0; p < 2; p++)
+    {
+        float* restrict y = batch->paddle_y[p];
+        float* restrict vy = batch->paddle_vy[p];
+        for (size_t i = begin; i < end; i++)
+        {
+            float v = vy[i] / 2.f;
+            v = (inputs[i].paddles[p] & INPUT_UP) ? 10.f : v;
+            v = (inputs[i].paddles[p] & INPUT_DOWN) ? -10.f : v;
+            vy[i] = v;
+
+            float newy = y[i] + v;
+            newy = (newy < 0) ? 0.f : (newy + paddle_size.y > 600.f) ? 600.f - paddle_size.y : newy;
+            y[i] = newy;
+        }
+    }
+
+    // Ball: movement and wall bounce (CheckBallWallCollision)
+    {
+        float* restrict x = batch->ball_x;
+        float* restrict y = batch->ball_y;
+        float* restrict vx = batch->ball_vx;
+        float* restrict vy = batch->ball_vy;
+        for (size_t i = begin; i < end; i++)
+        {
+            x[i] += vx[i];
+            float newy = y[i] + vy[i];
+            y[i] = newy;
+            vy[i] = (newy - ball_radius < 0.f || newy + ball_radius > 600.f) ? -vy[i] : vy[i];
+        }
+    }
+
+    for (size_t i = begin; i < end; i++)
+    {
+        ResolveBatchMatch(batch, i);
+    }
+}
+
+void StepGameBatchScalar(GameBatch* batch, const GameInput* inputs)
+{
+    StepGameBatchRange(batch, inputs, 0, batch->count);
+}
+
+// The SIMD kernels below step 8 or 4 matches per iteration with branchless
+// masks for input, paddle clamping and wall bounces (v / 2 is computed as the
+// exactly equal v * 0.5). Lanes that touch a paddle or score are handed to
+// ResolveBatchMatch in ascending order, and the tail goes through the
+// reference kernel, so results are identical to StepGameBatchScalar.
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define HAVE_BATCH_SSE
+#define HAVE_BATCH_AVX2
+
+__attribute__((target("avx2")))
+static void StepGameBatchAVX2(GameBatch* batch, const GameInput* inputs)
+{
+    const size_t n = batch->count;
+    const size_t blocks = n & ~(size_t)7;
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 up_speed = _mm256_set1_ps(10.f);
+    const __m256 down_speed = _mm256_set1_ps(-10.f);
+    const __m256 court_height = _mm256_set1_ps(600.f);
+    const __m256 court_width = _mm256_set1_ps(800.f);
+    const __m256 paddle_h = _mm256_set1_ps(paddle_size.y);
+    const __m256 paddle_max_y = _mm256_set1_ps(600.f - paddle_size.y);
+    const __m256 radius = _mm256_set1_ps(ball_radius);
+    const __m256 sign = _mm256_set1_ps(-0.f);
+
+    for (size_t i = 0; i < blocks; i += 8)
+    {
+        // One 32-bit lane per match holding paddles[0] | paddles[1] << 8
+        __m256i in = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(inputs + i)));
+        __m256 hits = zero;
+
+        __m256 x = _mm256_add_ps(_mm256_load_ps(batch->ball_x + i), _mm256_load_ps(batch->ball_vx + i));
+        __m256 y = _mm256_add_ps(_mm256_load_ps(batch->ball_y + i), _mm256_load_ps(batch->ball_vy + i));
+
+        for (int p = 0; p < 2; p++)
+        {
+            const __m256i up_bit = _mm256_set1_epi32(INPUT_UP << (8 * p));
+            const __m256i down_bit = _mm256_set1_epi32(INPUT_DOWN << (8 * p));
+            __m256 up = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(in, up_bit), up_bit));
+            __m256 down = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(in, down_bit), down_bit));
+
+            __m256 v = _mm256_mul_ps(_mm256_load_ps(batch->paddle_vy[p] + i), half);
+            v = _mm256_blendv_ps(v, up_speed, up);
+            v = _mm256_blendv_ps(v, down_speed, down);
+            _mm256_store_ps(batch->paddle_vy[p] + i, v);
+
+            __m256 py = _mm256_add_ps(_mm256_load_ps(batch->paddle_y[p] + i), v);
+            __m256 below = _mm256_cmp_ps(py, zero, _CMP_LT_OQ);
+            __m256 above = _mm256_cmp_ps(_mm256_add_ps(py, paddle_h), court_height, _CMP_GT_OQ);
+            py = _mm256_blendv_ps(py, paddle_max_y, above);
+            py = _mm256_blendv_ps(py, zero, below);
+            _mm256_store_ps(batch->paddle_y[p] + i, py);
+
+            __m256 inside = _mm256_and_ps(_mm256_cmp_ps(x, _mm256_set1_ps(paddle_x[p]), _CMP_GT_OQ), _mm256_cmp_ps(x, _mm256_set1_ps(paddle_x[p] + paddle_size.x), _CMP_LT_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(y, py, _CMP_GT_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(y, _mm256_add_ps(py, paddle_h), _CMP_LT_OQ));
+            hits = _mm256_or_ps(hits, inside);
+        }
+
+        __m256 wall = _mm256_or_ps(_mm256_cmp_ps(_mm256_sub_ps(y, radius), zero, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(y, radius), court_height, _CMP_GT_OQ));
+        __m256 vy = _mm256_xor_ps(_mm256_load_ps(batch->ball_vy + i), _mm256_and_ps(wall, sign));
+        _mm256_store_ps(batch->ball_x + i, x);
+        _mm256_store_ps(batch->ball_y + i, y);
+        _mm256_store_ps(batch->ball_vy + i, vy);
+
+        hits = _mm256_or_ps(hits, _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+        hits = _mm256_or_ps(hits, _mm256_cmp_ps(x, court_width, _CMP_GT_OQ));
+        unsigned int mask = (unsigned int)_mm256_movemask_ps(hits);
+        while (mask)
+        {
+            ResolveBatchMatch(batch, i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    StepGameBatchRange(batch, inputs, blocks, n);
+}
+
+__attribute__((target("sse2")))
+static inline __m128 SelectSSE(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+__attribute__((target("sse2")))
+static void StepGameBatchSSE(GameBatch* batch, const GameInput* inputs)
+{
+    const size_t n = batch->count;
+    const size_t blocks = n & ~(size_t)3;
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 up_speed = _mm_set1_ps(10.f);
+    const __m128 down_speed = _mm_set1_ps(-10.f);
+    const __m128 court_height = _mm_set1_ps(600.f);
+    const __m128 court_width = _mm_set1_ps(800.f);
+    const __m128 paddle_h = _mm_set1_ps(paddle_size.y);
+    const __m128 paddle_max_y = _mm_set1_ps(600.f - paddle_size.y);
+    const __m128 radius = _mm_set1_ps(ball_radius);
+    const __m128 sign = _mm_set1_ps(-0.f);
+
+    for (size_t i = 0; i < blocks; i += 4)
+    {
+        __m128i in = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(inputs + i)), _mm_setzero_si128());
+        __m128 hits = zero;
+
+        __m128 x = _mm_add_ps(_mm_load_ps(batch->ball_x + i), _mm_load_ps(batch->ball_vx + i));
+        __m128 y = _mm_add_ps(_mm_load_ps(batch->ball_y + i), _mm_load_ps(batch->ball_vy + i));
+
+        for (int p = 0; p < 2; p++)
+        {
+            const __m128i up_bit = _mm_set1_epi32(INPUT_UP << (8 * p));
+            const __m128i down_bit = _mm_set1_epi32(INPUT_DOWN << (8 * p));
+            __m128 up = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(in, up_bit), up_bit));
+            __m128 down = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(in, down_bit), down_bit));
+
+            __m128 v = _mm_mul_ps(_mm_load_ps(batch->paddle_vy[p] + i), half);
+            v = SelectSSE(up, up_speed, v);
+            v = SelectSSE(down, down_speed, v);
+            _mm_store_ps(batch->paddle_vy[p] + i, v);
+
+            __m128 py = _mm_add_ps(_mm_load_ps(batch->paddle_y[p] + i), v);
+            __m128 below = _mm_cmplt_ps(py, zero);
+            __m128 above = _mm_cmpgt_ps(_mm_add_ps(py, paddle_h), court_height);
+            py = SelectSSE(above, paddle_max_y, py);
+            py = SelectSSE(below, zero, py);
+            _mm_store_ps(batch->paddle_y[p] + i, py);
+
+            __m128 inside = _mm_and_ps(_mm_cmpgt_ps(x, _mm_set1_ps(paddle_x[p])), _mm_cmplt_ps(x, _mm_set1_ps(paddle_x[p] + paddle_size.x)));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(y, py));
+            inside = _mm_and_ps(inside, _mm_cmplt_ps(y, _mm_add_ps(py, paddle_h)));
+            hits = _mm_or_ps(hits, inside);
+        }
+
+        __m128 wall = _mm_or_ps(_mm_cmplt_ps(_mm_sub_ps(y, radius), zero), _mm_cmpgt_ps(_mm_add_ps(y, radius), court_height));
+        __m128 vy = _mm_xor_ps(_mm_load_ps(batch->ball_vy + i), _mm_and_ps(wall, sign));
+        _mm_store_ps(batch->ball_x + i, x);
+        _mm_store_ps(batch->ball_y + i, y);
+        _mm_store_ps(batch->ball_vy + i, vy);
+
+        hits = _mm_or_ps(hits, _mm_cmplt_ps(x, zero));
+        hits = _mm_or_ps(hits, _mm_cmpgt_ps(x, court_width));
+        unsigned int mask = (unsigned int)_mm_movemask_ps(hits);
+        while (mask)
+        {
+            ResolveBatchMatch(batch, i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    StepGameBatchRange(batch, inputs, blocks, n);
+}
+#endif
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+
+#define HAVE_BATCH_NEON
+
+static void StepGameBatchNEON(GameBatch* batch, const GameInput* inputs)
+{
+    const size_t n = batch->count;
+    const size_t blocks = n & ~(size_t)3;
+
+    const float32x4_t zero = vdupq_n_f32(0.f);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const float32x4_t up_speed = vdupq_n_f32(10.f);
+    const float32x4_t down_speed = vdupq_n_f32(-10.f);
+    const float32x4_t court_height = vdupq_n_f32(600.f);
+    const float32x4_t court_width = vdupq_n_f32(800.f);
+    const float32x4_t paddle_h = vdupq_n_f32(paddle_size.y);
+    const float32x4_t paddle_max_y = vdupq_n_f32(600.f - paddle_size.y);
+    const float32x4_t radius = vdupq_n_f32(ball_radius);
+
+    for (size_t i = 0; i < blocks; i += 4)
+    {
+        uint32x4_t in = vmovl_u16(vld1_u16((const uint16_t*)(inputs + i)));
+        uint32x4_t hits = vdupq_n_u32(0);
+
+        float32x4_t x = vaddq_f32(vld1q_f32(batch->ball_x + i), vld1q_f32(batch->ball_vx + i));
+        float32x4_t y = vaddq_f32(vld1q_f32(batch->ball_y + i), vld1q_f32(batch->ball_vy + i));
+
+        for (int p = 0; p < 2; p++)
+        {
+            uint32x4_t up = vtstq_u32(in, vdupq_n_u32(INPUT_UP << (8 * p)));
+            uint32x4_t down = vtstq_u32(in, vdupq_n_u32(INPUT_DOWN << (8 * p)));
+
+            float32x4_t v = vmulq_f32(vld1q_f32(batch->paddle_vy[p] + i), half);
+            v = vbslq_f32(up, up_speed, v);
+            v = vbslq_f32(down, down_speed, v);
+            vst1q_f32(batch->paddle_vy[p] + i, v);
+
+            float32x4_t py = vaddq_f32(vld1q_f32(batch->paddle_y[p] + i), v);
+            uint32x4_t below = vcltq_f32(py, zero);
+            uint32x4_t above = vcgtq_f32(vaddq_f32(py, paddle_h), court_height);
+            py = vbslq_f32(above, paddle_max_y, py);
+            py = vbslq_f32(below, zero, py);
+            vst1q_f32(batch->paddle_y[p] + i, py);
+
+            uint32x4_t inside = vandq_u32(vcgtq_f32(x, vdupq_n_f32(paddle_x[p])), vcltq_f32(x, vdupq_n_f32(paddle_x[p] + paddle_size.x)));
+            inside = vandq_u32(inside, vcgtq_f32(y, py));
+            inside = vandq_u32(inside, vcltq_f32(y, vaddq_f32(py, paddle_h)));
+            hits = vorrq_u32(hits, inside);
+        }
+
+        uint32x4_t wall = vorrq_u32(vcltq_f32(vsubq_f32(y, radius), zero), vcgtq_f32(vaddq_f32(y, radius), court_height));
+        float32x4_t vy = vld1q_f32(batch->ball_vy + i);
+        vy = vbslq_f32(wall, vnegq_f32(vy), vy);
+        vst1q_f32(batch->ball_x + i, x);
+        vst1q_f32(batch->ball_y + i, y);
+        vst1q_f32(batch->ball_vy + i, vy);
+
+        hits = vorrq_u32(hits, vcltq_f32(x, zero));
+        hits = vorrq_u32(hits, vcgtq_f32(x, court_width));
+        if (vmaxvq_u32(hits)) {
+            uint32_t lanes[4];
+            vst1q_u32(lanes, hits);
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (lanes[lane]) ResolveBatchMatch(batch, i + lane);
+            }
+        }
+    }
+
+    StepGameBatchRange(batch, inputs, blocks, n);
+}
+#endif
+
+typedef void (*StepGameBatchFunc)(GameBatch* batch, const GameInput* inputs);
+
+static BatchKernel batch_kernel = BATCH_KERNEL_AUTO;
+static StepGameBatchFunc step_game_batch = NULL;
+
+int BatchKernelSupported(BatchKernel kernel)
+{
+    switch (kernel) {
+        case BATCH_KERNEL_AUTO:
+        case BATCH_KERNEL_SCALAR:
+            return 1;
+#ifdef HAVE_BATCH_SSE
+        case BATCH_KERNEL_SSE:
+            return __builtin_cpu_supports("sse2");
+#endif
+#ifdef HAVE_BATCH_AVX2
+        case BATCH_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+#ifdef HAVE_BATCH_NEON
+        case BATCH_KERNEL_NEON:
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+int SetBatchKernel(BatchKernel kernel)
+{
+    if (kernel == BATCH_KERNEL_AUTO) {
+        kernel = BATCH_KERNEL_SCALAR;
+        if (BatchKernelSupported(BATCH_KERNEL_NEON)) kernel = BATCH_KERNEL_NEON;
+        if (BatchKernelSupported(BATCH_KERNEL_SSE)) kernel = BATCH_KERNEL_SSE;
+        if (BatchKernelSupported(BATCH_KERNEL_AVX2)) kernel = BATCH_KERNEL_AVX2;
+    }
+    if (!BatchKernelSupported(kernel)) return 0;
+
+    switch (kernel) {
+#ifdef HAVE_BATCH_SSE
+        case BATCH_KERNEL_SSE: step_game_batch = StepGameBatchSSE; break;
+#endif
+#ifdef HAVE_BATCH_AVX2
+        case BATCH_KERNEL_AVX2: step_game_batch = StepGameBatchAVX2; break;
+#endif
+#ifdef HAVE_BATCH_NEON
+        case BATCH_KERNEL_NEON: step_game_batch = StepGameBatchNEON; break;
+#endif
+        default: step_game_batch = StepGameBatchScalar; break;
+    }
+    batch_kernel = kernel;
+
+    return 1;
+}
+
+BatchKernel GetBatchKernel()
+{
+    if (step_game_batch == NULL) SetBatchKernel(BATCH_KERNEL_AUTO);
+    return batch_kernel;
+}
+
+const char* BatchKernelName(BatchKernel kernel)
+{
+    switch (kernel) {
+        case BATCH_KERNEL_AUTO: return "auto";
+        case BATCH_KERNEL_SCALAR: return "scalar";
+        case BATCH_KERNEL_SSE: return "sse";
+        case BATCH_KERNEL_AVX2: return "avx2";
+        case BATCH_KERNEL_NEON: return "neon";
+        default: return "unknown";
+    }
+}
+
+void StepGameBatch(GameBatch* batch, const GameInput* inputs)
+{
+    if (step_game_batch == NULL) SetBatchKernel(BATCH_KERNEL_AUTO);
+    step_game_batch(batch, inputs);
+}
@@ -0,0 +1,77 @@
+#include "clock.h"
+#include <math.h>
+
+void InitClockSync(ClockSync* clock)
+{
+    clock->count = 0;
+    clock->next = 0;
+    clock->offset = 0.0;
+    clock->offset_time = 0.0;
+    clock->drift = 0.0;
+    clock->drift_offset = 0.0;
+    clock->drift_time = -1.0;
+    clock->rtt = 0.0;
+    clock->rtt_jitter = 0.0;
+    clock->min_rtt = 0.0;
+    clock->error = 0.0;
+}
+
+int ClockSynced(const ClockSync* clock)
+{
+    return clock->count > 0;
+}
+
+double RemoteTime(const ClockSync* clock, double local)
+{
+    return local + clock->offset + clock->drift * (local - clock->offset_time);
+}
+
+void AddClockSample(ClockSync* clock, double sent, double remote, double received)
+{
+    double rtt = received - sent;
+    if (rtt < 0.0) return;
+    ClockSample sample = {sent + rtt / 2.0, rtt, remote - (sent + rtt / 2.0)};
+
+    if (clock->count == 0) {
+        clock->rtt = rtt;
+        clock->rtt_jitter = rtt / 2.0;
+    } else {
+        clock->error += (fabs(sample.offset - (RemoteTime(clock, sample.time) - sample.time)) - clock->error) / 8.0;
+        clock->rtt_jitter += (fabs(rtt - clock->rtt) - clock->rtt_jitter) / 4.0;
+        clock->rtt += (rtt - clock->rtt) / 8.0;
+    }
+    clock->samples[clock->next] = sample;
+    clock->next = (clock->next + 1) % CLOCK_SAMPLES;
+    if (clock->count < CLOCK_SAMPLES) clock->count++;
+
+    // Clock filter: trust the least delayed sample in the window
+    const ClockSample* best = &clock->samples[0];
+    for (unsigned int i = 1; i < clock->count; i++)
+    {
+        if (clock->samples[i].rtt < best->rtt) best = &clock->samples[i];
+    }
+    clock->min_rtt = best->rtt;
+    if (best->time == clock->offset_time) return;
+    clock->offset = best->offset;
+    clock->offset_time = best->time;
+
+    // Drift from filtered offsets far enough apart that their own error
+    // (up to min_rtt / 2 each) stays small against the span
+    if (clock->drift_time < 0.0) {
+        clock->drift_offset = best->offset;
+        clock->drift_time = best->time;
+    } else if (best->time - clock->drift_time >= CLOCK_DRIFT_SPAN) {
+        double drift = (best->offset - clock->drift_offset) / (best->time - clock->drift_time);
+        clock->drift += (drift - clock->drift) / 4.0;
+        if (clock->drift > CLOCK_MAX_DRIFT) clock->drift = CLOCK_MAX_DRIFT;
+        if (clock->drift < -CLOCK_MAX_DRIFT) clock->drift = -CLOCK_MAX_DRIFT;
+        clock->drift_offset = best->offset;
+        clock->drift_time = best->time;
+    }
+}
+
+double ClockSlew(double error, double dt)
+{
+    double limit = CLOCK_MAX_SLEW * dt;
+    return error > limit ? limit : error < -limit ? -limit : error;
+}
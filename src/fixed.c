@@ -0,0 +1,307 @@
+#include "fixed.h"
+#include <stdio.h>
+
+#define BALL_RADIUS INT_TO_FIXED(5)
+#define BALL_SPEED INT_TO_FIXED(10)
+#define PADDLE_SPEED INT_TO_FIXED(10)
+#define PADDLE_WIDTH INT_TO_FIXED(20)
+#define PADDLE_HEIGHT INT_TO_FIXED(100)
+#define COURT_WIDTH INT_TO_FIXED(800)
+#define COURT_HEIGHT INT_TO_FIXED(600)
+
+// Paddle hits reflect at angle distanceToCenter / 50 * pi / 4, quantized to
+// this many steps between the paddle centre and its edge
+#define BOUNCE_STEPS 64
+
+static const Fixed paddle_x[2] = {INT_TO_FIXED(-10), INT_TO_FIXED(790)};
+
+// 10 * cos and 10 * sin of (i / 64) * (pi / 4), in 16.16
+static const Fixed bounce_cos[BOUNCE_STEPS + 1] = {
+    655360, 655311, 655163, 654916, 654571, 654127, 653584, 652943,
+    652204, 651367, 650431, 649398, 648267, 647038, 645712, 644288,
+    642767, 641150, 639436, 637626, 635720, 633718, 631620, 629428,
+    627140, 624759, 622283, 619713, 617050, 614294, 611446, 608506,
+    605474, 602350, 599137, 595832, 592438, 588955, 585383, 581724,
+    577976, 574141, 570220, 566213, 562121, 557944, 553683, 549339,
+    544912, 540403, 535812, 531141, 526390, 521560, 516651, 511664,
+    506600, 501460, 496244, 490954, 485590, 480152, 474643, 469061,
+    463410,
+};
+
+static const Fixed bounce_sin[BOUNCE_STEPS + 1] = {
+    0, 8042, 16083, 24122, 32157, 40187, 48211, 56228,
+    64237, 72235, 80223, 88199, 96161, 104109, 112042, 119957,
+    127854, 135733, 143590, 151426, 159239, 167029, 174793, 182531,
+    190241, 197923, 205574, 213195, 220784, 228340, 235861, 243346,
+    250795, 258207, 265579, 272911, 280203, 287452, 294657, 301819,
+    308935, 316004, 323026, 329999, 336922, 343795, 350616, 357384,
+    364099, 370758, 377362, 383908, 390397, 396828, 403198, 409508,
+    415756, 421941, 428063, 434121, 440113, 446039, 451897, 457688,
+    463410,
+};
+
+// 10 * cos and 10 * sin of 0..45 degrees, in 16.16; the serve angles InitBall accepts
+static const Fixed serve_cos[46] = {
+    655360, 655260, 654961, 654462, 653764, 652866, 651770, 650475,
+    648982, 647291, 645404, 643319, 641039, 638563, 635893, 633029,
+    629972, 626724, 623284, 619655, 615837, 611831, 607639, 603262,
+    598701, 593958, 589034, 583930, 578649, 573191, 567558, 561753,
+    555777, 549631, 543318, 536839, 530197, 523394, 516431, 509310,
+    502035, 494606, 487027, 479300, 471427, 463410,
+};
+
+static const Fixed serve_sin[46] = {
+    0, 11438, 22872, 34299, 45716, 57118, 68504, 79868,
+    91208, 102521, 113802, 125049, 136257, 147424, 158546, 169620,
+    180642, 191609, 202517, 213364, 224146, 234860, 245502, 256070,
+    266559, 276967, 287291, 297527, 307673, 317725, 327680, 337535,
+    347288, 356935, 366473, 375899, 385211, 394405, 403480, 412431,
+    421257, 429955, 438521, 446954, 455251, 463410,
+};
+
+FixedBall InitFixedBall(Rng* rng)
+{
+    FixedBall ball;
+    ball.x = INT_TO_FIXED(400);
+    ball.y = INT_TO_FIXED(300);
+
+    // Same draws and rejections as InitBall: |cos| >= 0.7 keeps 0..45 degrees around either x direction
+    int angle_deg;
+    do {
+        angle_deg = (int)RngBounded(rng, 360);
+    } while ((angle_deg > 45 && angle_deg < 135) || (angle_deg > 225 && angle_deg < 315));
+
+    // Fold to an offset from the x axis in [-45, 45] and a direction
+    int offset = angle_deg;
+    Fixed direction = 1;
+    if (angle_deg >= 315) {
+        offset = angle_deg - 360;
+    } else if (angle_deg >= 135) {
+        offset = angle_deg - 180;
+        direction = -1;
+    }
+    int index = offset < 0 ? -offset : offset;
+    ball.vx = direction * serve_cos[index];
+    ball.vy = direction * (offset < 0 ? -serve_sin[index] : serve_sin[index]);
+
+    return ball;
+}
+
+FixedGameState InitFixedGameState(Rng rng)
+{
+    FixedGameState state;
+    state.rng = rng;
+    state.ball = InitFixedBall(&state.rng);
+    for (int p = 0; p < 2; p++)
+    {
+        state.paddles[p].y = INT_TO_FIXED(300);
+        state.paddles[p].vy = 0;
+        state.paddles[p].score = 0;
+    }
+
+    return state;
+}
+
+static void BounceFixedBall(FixedBall* ball, Fixed paddle_y)
+{
+    const int64_t half_height = PADDLE_HEIGHT / 2;
+    int64_t distance = (int64_t)ball->y - (paddle_y + half_height);
+
+    // Round half away from zero to the nearest table step
+    int64_t scaled = distance * BOUNCE_STEPS;
+    int index = (int)((scaled + (scaled >= 0 ? half_height / 2 : -half_height / 2)) / half_height);
+    if (index > BOUNCE_STEPS) index = BOUNCE_STEPS;
+    if (index < -BOUNCE_STEPS) index = -BOUNCE_STEPS;
+
+    int step = index < 0 ? -index : index;
+    ball->vx = ball->vx < 0 ? bounce_cos[step] : -bounce_cos[step];
+    ball->vy = index < 0 ? -bounce_sin[step] : bounce_sin[step];
+}
+
+static void NewSetFixed(FixedGameState* state)
+{
+    state->ball = InitFixedBall(&state->rng);
+    state->paddles[0].y = INT_TO_FIXED(300);
+    state->paddles[1].y = INT_TO_FIXED(300);
+}
+
+void UpdateGameFixed(FixedGameState* state, GameInput input)
+{
+    for (int p = 0; p < 2; p++)
+    {
+        FixedPaddle* paddle = &state->paddles[p];
+        paddle->vy /= 2;
+        if (input.paddles[p] & INPUT_UP) {
+            paddle->vy = PADDLE_SPEED;
+        }
+        if (input.paddles[p] & INPUT_DOWN) {
+            paddle->vy = -PADDLE_SPEED;
+        }
+
+        // Collision between paddle and walls
+        paddle->y += paddle->vy;
+        if (paddle->y < 0) {
+            paddle->y = 0;
+        } else if (paddle->y + PADDLE_HEIGHT > COURT_HEIGHT) {
+            paddle->y = COURT_HEIGHT - PADDLE_HEIGHT;
+        }
+    }
+
+    FixedBall* ball = &state->ball;
+    ball->x += ball->vx;
+    ball->y += ball->vy;
+
+    // Collision between ball and walls
+    if (ball->y - BALL_RADIUS < 0 || ball->y + BALL_RADIUS > COURT_HEIGHT) {
+        ball->vy = -ball->vy;
+    }
+
+    // Collision between ball and paddles
+    for (int p = 0; p < 2; p++)
+    {
+        Fixed py = state->paddles[p].y;
+        if (ball->x > paddle_x[p] && ball->x < paddle_x[p] + PADDLE_WIDTH && ball->y > py && ball->y < py + PADDLE_HEIGHT) {
+            BounceFixedBall(ball, py);
+        }
+    }
+
+    if (ball->x < 0) {
+        state->paddles[1].score++;
+        NewSetFixed(state);
+    } else if (ball->x > COURT_WIDTH) {
+        state->paddles[0].score++;
+        NewSetFixed(state);
+    }
+}
+
+// Ticks a paddle can take before something other than y += v happens,
+// with its per-tick velocity for that stretch; -1 for never
+static int64_t PaddleLinearTicks(const FixedPaddle* paddle, unsigned char input, Fixed* velocity)
+{
+    if (!(input & (INPUT_UP | INPUT_DOWN))) {
+        // Released: vy halves every tick until it reaches zero
+        *velocity = 0;
+        return paddle->vy == 0 ? -1 : 0;
+    }
+
+    Fixed v = (input & INPUT_DOWN) ? -PADDLE_SPEED : PADDLE_SPEED;
+    *velocity = v;
+    if (v > 0) {
+        if (paddle->y == COURT_HEIGHT - PADDLE_HEIGHT) return -1; // held against the top
+        return (COURT_HEIGHT - PADDLE_HEIGHT - paddle->y) / v;
+    }
+    if (paddle->y == 0) return -1; // held against the bottom
+    return paddle->y / -v;
+}
+
+// Ticks until a value moving by step per tick leaves [lo, hi]; -1 for never
+static int64_t TicksInRange(int64_t value, int64_t step, int64_t lo, int64_t hi)
+{
+    if (value < lo || value > hi) return 0;
+    if (step > 0) return (hi - value) / step;
+    if (step < 0) return (value - lo) / -step;
+    return -1;
+}
+
+// Ticks the ball can take without touching a wall, entering a paddle's
+// column or leaving the court; -1 for never
+static int64_t BallLinearTicks(const FixedBall* ball)
+{
+    int64_t ticks = TicksInRange(ball->x, ball->vx, paddle_x[0] + PADDLE_WIDTH, paddle_x[1]);
+    int64_t limit = TicksInRange(ball->y, ball->vy, BALL_RADIUS, COURT_HEIGHT - BALL_RADIUS);
+    if (limit >= 0 && (ticks < 0 || limit < ticks)) ticks = limit;
+
+    return ticks;
+}
+
+unsigned long AdvanceGameFixed(FixedGameState* state, GameInput input, unsigned long ticks)
+{
+    unsigned long stepped = 0;
+
+    while (ticks > 0)
+    {
+        // Longest stretch where every body moves in a straight line
+        int64_t span = (int64_t)ticks;
+        Fixed paddle_v[2];
+        for (int p = 0; p < 2; p++)
+        {
+            int64_t limit = PaddleLinearTicks(&state->paddles[p], input.paddles[p], &paddle_v[p]);
+            if (limit >= 0 && limit < span) span = limit;
+        }
+        int64_t limit = BallLinearTicks(&state->ball);
+        if (limit >= 0 && limit < span) span = limit;
+
+        if (span == 0) {
+            // Something happens on the next tick: run it exactly
+            UpdateGameFixed(state, input);
+            ticks--;
+            stepped++;
+            continue;
+        }
+
+        state->ball.x += (Fixed)(span * state->ball.vx);
+        state->ball.y += (Fixed)(span * state->ball.vy);
+        for (int p = 0; p < 2; p++)
+        {
+            FixedPaddle* paddle = &state->paddles[p];
+            if (input.paddles[p] & (INPUT_UP | INPUT_DOWN)) {
+                paddle->vy = paddle_v[p];
+                // A paddle held against a wall is clamped back every tick
+                int at_wall = (paddle_v[p] > 0 && paddle->y == COURT_HEIGHT - PADDLE_HEIGHT) || (paddle_v[p] < 0 && paddle->y == 0);
+                if (!at_wall) {
+                    paddle->y += (Fixed)(span * paddle_v[p]);
+                }
+            }
+        }
+        ticks -= (unsigned long)span;
+    }
+
+    return stepped;
+}
+
+GameState FixedToGameState(const FixedGameState* state)
+{
+    GameState ret;
+    ret.ball.position = (MiniVector2){(float)state->ball.x / FIXED_ONE, (float)state->ball.y / FIXED_ONE};
+    ret.ball.radius = (float)BALL_RADIUS / FIXED_ONE;
+    ret.ball.velocity = (MiniVector2){(float)state->ball.vx / FIXED_ONE, (float)state->ball.vy / FIXED_ONE};
+    for (int p = 0; p < 2; p++)
+    {
+        ret.paddles[p] = InitPaddle((float)paddle_x[p] / FIXED_ONE, (float)state->paddles[p].y / FIXED_ONE);
+        ret.paddles[p].velocity.y = (float)state->paddles[p].vy / FIXED_ONE;
+        ret.paddles[p].score = state->paddles[p].score;
+        snprintf(ret.paddles[p].score_string, sizeof(ret.paddles[p].score_string), "Score: %u", ret.paddles[p].score);
+    }
+    ret.rng = state->rng;
+
+    return ret;
+}
+
+static uint64_t HashBytes(uint64_t hash, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+    {
+        hash ^= (value >> (8 * i)) & 0xff;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+uint64_t HashFixedGameState(const FixedGameState* state)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    hash = HashBytes(hash, (uint32_t)state->ball.x, 4);
+    hash = HashBytes(hash, (uint32_t)state->ball.y, 4);
+    hash = HashBytes(hash, (uint32_t)state->ball.vx, 4);
+    hash = HashBytes(hash, (uint32_t)state->ball.vy, 4);
+    for (int p = 0; p < 2; p++)
+    {
+        hash = HashBytes(hash, (uint32_t)state->paddles[p].y, 4);
+        hash = HashBytes(hash, (uint32_t)state->paddles[p].vy, 4);
+        hash = HashBytes(hash, state->paddles[p].score, 4);
+    }
+    hash = HashBytes(hash, state->rng.state, 8);
+
+    return hash;
+}
@@ -0,0 +1,289 @@
+#include "game.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#define MINIMATH_IMPLEMENTATION
+#include "minimath.h"
+
+Ball InitBall(Rng* rng)
+{
+    Ball ball;
+    ball.position = (MiniVector2){400.f, 300.f};
+    ball.radius = 5.f;
+    float angle;
+    do {
+        int angle_deg = (int)RngBounded(rng, 360); // angle in degrees
+        angle = deg2rad((float)angle_deg);
+    } while (fabs(cos(angle)) < 0.7f);
+    ball.velocity = (MiniVector2){cos(angle) * 10.f, sin(angle) * 10.f};
+
+    return ball;
+}
+
+Paddle InitPaddle(float x, float y)
+{
+    Paddle paddle;
+    paddle.position = (MiniVector2){x, y};
+    paddle.size = (MiniVector2){20.f, 100.f};
+    paddle.velocity = (MiniVector2){0.f, 0.f};
+    paddle.score = 0;
+    strncpy(paddle.score_string, "Score: 0", sizeof(paddle.score_string));
+    return paddle;
+}
+
+GameState InitGameState(Rng rng)
+{
+    GameState state;
+    state.rng = rng;
+    state.ball = InitBall(&state.rng);
+    state.paddles[0] = InitPaddle(-10.f, 300.f);
+    state.paddles[1] = InitPaddle(790.f, 300.f);
+
+    return state;
+}
+
+Paddle CheckPaddleCollision(Paddle paddle)
+{
+    Paddle newpaddle = paddle;
+
+    if (paddle.position.y < 0) {
+        newpaddle.position.y = 0;
+    } else if (paddle.position.y + paddle.size.y > 600.f) {
+        newpaddle.position.y = 600.f - paddle.size.y;
+    }
+
+    return newpaddle;
+}
+
+Ball CheckBallWallCollision(Ball ball)
+{
+    Ball newball = ball;
+
+    if (ball.position.y - ball.radius < 0.f || ball.position.y + ball.radius > 600.f) {
+        newball.velocity.y = -ball.velocity.y;
+    }
+
+    return newball;
+}
+
+Ball CheckBallPaddleCollision(Ball ball, Paddle paddle)
+{
+    Ball newball = ball;
+
+    if (ball.position.x > paddle.position.x && ball.position.x < paddle.position.x + paddle.size.x && ball.position.y > paddle.position.y && ball.position.y < paddle.position.y + paddle.size.y) {
+
+        float distanceToCenter = ball.position.y - (paddle.position.y + paddle.size.y / 2);
+        float angle = distanceToCenter / 50.f * M_PI / 4.f;
+        if (ball.velocity.x < 0) {
+            newball.velocity.x = cos(angle) * 10.f;
+            newball.velocity.y = sin(angle) * 10.f;
+        } else {
+            newball.velocity.x = -cos(angle) * 10.f;
+            newball.velocity.y = sin(angle) * 10.f;
+        }
+    }
+
+
+    return newball;
+}
+
+void NewSet(GameState* state)
+{
+    state->ball = InitBall(&state->rng);
+    state->paddles[0].position = (MiniVector2){-10.f, 300.f};
+    state->paddles[1].position = (MiniVector2){790.f, 300.f};
+}
+
+// Earliest time in [0, 1] at which the point p + t * d enters box, or -1
+static float RayBoxEntry(MiniVector2 p, MiniVector2 d, MiniRect box)
+{
+    float tmin = 0.f;
+    float tmax = 1.f;
+    float origin[2] = {p.x, p.y};
+    float dir[2] = {d.x, d.y};
+    float lo[2] = {box.x, box.y};
+    float hi[2] = {box.x + box.w, box.y + box.h};
+
+    for (int axis = 0; axis < 2; axis++)
+    {
+        if (dir[axis] == 0.f) {
+            if (origin[axis] < lo[axis] || origin[axis] > hi[axis]) return -1.f;
+            continue;
+        }
+        float t1 = (lo[axis] - origin[axis]) / dir[axis];
+        float t2 = (hi[axis] - origin[axis]) / dir[axis];
+        if (t1 > t2) {
+            float tmp = t1;
+            t1 = t2;
+            t2 = tmp;
+        }
+        if (t1 > tmin) tmin = t1;
+        if (t2 < tmax) tmax = t2;
+        if (tmin > tmax) return -1.f;
+    }
+
+    return tmin;
+}
+
+// Earliest time in [0, 1] at which p + t * d comes within radius of center, or -1
+static float RayCircleEntry(MiniVector2 p, MiniVector2 d, MiniVector2 center, float radius)
+{
+    MiniVector2 m = {p.x - center.x, p.y - center.y};
+    float a = d.x * d.x + d.y * d.y;
+    float b = m.x * d.x + m.y * d.y;
+    float c = m.x * m.x + m.y * m.y - radius * radius;
+    if (a == 0.f || b > 0.f) return -1.f; // not moving, or moving away
+
+    float discriminant = b * b - a * c;
+    if (discriminant < 0.f) return -1.f;
+    float t = (-b - sqrtf(discriminant)) / a;
+    return (t >= 0.f && t <= 1.f) ? t : -1.f;
+}
+
+int SweepBallPaddle(Ball ball, MiniVector2 motion, Paddle paddle, float* time)
+{
+    float r = ball.radius;
+    MiniVector2 p = ball.position;
+    MiniRect box = {paddle.position.x, paddle.position.y, paddle.size.x, paddle.size.y};
+
+    // A ball that already overlaps is on its way out after the last bounce
+    float dx = fmaxf(box.x - p.x, fmaxf(0.f, p.x - (box.x + box.w)));
+    float dy = fmaxf(box.y - p.y, fmaxf(0.f, p.y - (box.y + box.h)));
+    if (dx * dx + dy * dy <= r * r) return 0;
+
+    // The circle touches the box when its centre enters the box grown by the
+    // radius with rounded corners: two grown rectangles plus four corner circles
+    float best = -1.f;
+    float candidates[6];
+    candidates[0] = RayBoxEntry(p, motion, (MiniRect){box.x - r, box.y, box.w + 2.f * r, box.h});
+    candidates[1] = RayBoxEntry(p, motion, (MiniRect){box.x, box.y - r, box.w, box.h + 2.f * r});
+    candidates[2] = RayCircleEntry(p, motion, (MiniVector2){box.x, box.y}, r);
+    candidates[3] = RayCircleEntry(p, motion, (MiniVector2){box.x + box.w, box.y}, r);
+    candidates[4] = RayCircleEntry(p, motion, (MiniVector2){box.x, box.y + box.h}, r);
+    candidates[5] = RayCircleEntry(p, motion, (MiniVector2){box.x + box.w, box.y + box.h}, r);
+    for (int i = 0; i < 6; i++)
+    {
+        if (candidates[i] >= 0.f && (best < 0.f || candidates[i] < best)) {
+            best = candidates[i];
+        }
+    }
+
+    if (best < 0.f) return 0;
+    *time = best;
+    return 1;
+}
+
+// Same reflection rule as CheckBallPaddleCollision, keeping the ball's speed
+static Ball BounceBall(Ball ball, Paddle paddle)
+{
+    Ball newball = ball;
+
+    float distanceToCenter = ball.position.y - (paddle.position.y + paddle.size.y / 2);
+    distanceToCenter = fmaxf(-50.f, fminf(50.f, distanceToCenter));
+    float angle = distanceToCenter / 50.f * M_PI / 4.f;
+    float speed = MiniVector2Length(ball.velocity);
+    if (ball.velocity.x < 0) {
+        newball.velocity.x = cosf(angle) * speed;
+    } else {
+        newball.velocity.x = -cosf(angle) * speed;
+    }
+    newball.velocity.y = sinf(angle) * speed;
+
+    return newball;
+}
+
+static void UpdatePaddles(GameState* state, GameInput input)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        state->paddles[i].velocity.y /= 2.f;
+        if (input.paddles[i] & INPUT_UP) {
+            state->paddles[i].velocity.y = 10.f;
+        }
+        if (input.paddles[i] & INPUT_DOWN) {
+            state->paddles[i].velocity.y = -10.f;
+        }
+    }
+
+    state->paddles[0].position = MiniVector2Add(state->paddles[0].position, state->paddles[0].velocity);
+    state->paddles[1].position = MiniVector2Add(state->paddles[1].position, state->paddles[1].velocity);
+
+    // Collision between paddle and walls
+    state->paddles[0] = CheckPaddleCollision(state->paddles[0]);
+    state->paddles[1] = CheckPaddleCollision(state->paddles[1]);
+}
+
+static void CheckScore(GameState* state)
+{
+    if (state->ball.position.x < 0) {
+        state->paddles[1].score++;
+        snprintf(state->paddles[1].score_string, sizeof(state->paddles[1].score_string), "Score: %u", state->paddles[1].score);
+        NewSet(state);
+    } else if (state->ball.position.x > 800.f) {
+        state->paddles[0].score++;
+        snprintf(state->paddles[0].score_string, sizeof(state->paddles[0].score_string), "Score: %u", state->paddles[0].score);
+        NewSet(state);
+    }
+}
+
+void UpdateGame(GameState* state, GameInput input)
+{
+    UpdatePaddles(state, input);
+
+    state->ball.position = MiniVector2Add(state->ball.position, state->ball.velocity);
+
+    // Collision between ball and walls
+    state->ball = CheckBallWallCollision(state->ball);
+    state->ball = CheckBallPaddleCollision(state->ball, state->paddles[0]);
+    state->ball = CheckBallPaddleCollision(state->ball, state->paddles[1]);
+
+    CheckScore(state);
+}
+
+void UpdateGameSwept(GameState* state, GameInput input)
+{
+    UpdatePaddles(state, input);
+
+    // Move the ball through the tick event by event: find the earliest wall
+    // or paddle contact along the remaining motion, advance to it, bounce,
+    // and continue with what is left of the tick
+    Ball* ball = &state->ball;
+    float remaining = 1.f;
+    for (int bounce = 0; bounce < 4 && remaining > 0.f; bounce++)
+    {
+        MiniVector2 motion = {ball->velocity.x * remaining, ball->velocity.y * remaining};
+        float t = 1.f;
+        int hit = -1; // 0/1: paddle, 2: wall
+
+        if (motion.y > 0.f && ball->position.y + ball->radius + motion.y > 600.f) {
+            t = (600.f - ball->radius - ball->position.y) / motion.y;
+            hit = 2;
+        } else if (motion.y < 0.f && ball->position.y - ball->radius + motion.y < 0.f) {
+            t = (ball->radius - ball->position.y) / motion.y;
+            hit = 2;
+        }
+        if (t < 0.f) t = 0.f;
+
+        for (int p = 0; p < 2; p++)
+        {
+            float toi;
+            if (SweepBallPaddle(*ball, motion, state->paddles[p], &toi) && toi < t) {
+                t = toi;
+                hit = p;
+            }
+        }
+
+        ball->position.x += motion.x * t;
+        ball->position.y += motion.y * t;
+        if (hit == 2) {
+            ball->velocity.y = -ball->velocity.y;
+        } else if (hit >= 0) {
+            *ball = BounceBall(*ball, state->paddles[hit]);
+        } else {
+            break;
+        }
+        remaining *= 1.f - t;
+    }
+
+    CheckScore(state);
+}
@@ -0,0 +1,500 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "game.h"
+#include "batch.h"
+#include "runner.h"
+#include "fixed.h"
+#include "ai.h"
+#include "snapshot.h"
+
+// Runs bot-vs-bot matches without a window or GL context, as fast as the CPU allows.
+
+typedef struct HeadlessOptions {
+    unsigned long matches;
+    unsigned int points;        // a match ends when one side reaches this score
+    unsigned long max_ticks;    // ... or after this many ticks
+    uint64_t seed;
+    unsigned long batch_size;   // 0 steps one GameState at a time
+    BatchKernel kernel;
+    int verify;                 // check the batch kernel against the scalar reference
+    unsigned int threads;       // 0 runs on the calling thread only
+    int fixed;                  // use the fixed-point simulation
+    int swept;                  // use continuous ball collision (UpdateGameSwept)
+    int events;                 // fixed-point mode: advance between events (AdvanceGameFixed)
+    unsigned long interval;     // fixed-point mode: ticks between bot decisions
+    int predictive;             // bots aim at the predicted ball crossing (AiInput)
+    unsigned long snapshot_lag; // benchmark snapshot encoding against the state this many ticks back
+} HeadlessOptions;
+
+typedef struct HeadlessResult {
+    unsigned long long ticks;
+    unsigned long wins[2];
+    unsigned long long mismatches;
+    uint64_t hash;              // final states of the fixed-point matches
+    unsigned long long stepped; // ticks the event-driven engine stepped one by one
+    unsigned long long snapshots;
+    unsigned long long snapshot_bytes;
+    unsigned long long full_snapshots;  // no baseline yet: the first lag ticks of a match
+    unsigned long long full_bytes;
+    double snapshot_seconds;    // encoding and decoding only, not the simulation
+} HeadlessResult;
+
+static double GetSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Follows the ball with the paddle centre, with a small dead zone to avoid jitter
+static unsigned char BotInput(const GameState* state, int paddle)
+{
+    const Paddle* p = &state->paddles[paddle];
+    float center = p->position.y + p->size.y / 2.f;
+    if (state->ball.position.y > center + 10.f) return INPUT_UP;
+    if (state->ball.position.y < center - 10.f) return INPUT_DOWN;
+    return 0;
+}
+
+static unsigned char BotInputBatch(const GameBatch* batch, size_t i, int paddle)
+{
+    float center = batch->paddle_y[paddle][i] + 50.f;
+    if (batch->ball_y[i] > center + 10.f) return INPUT_UP;
+    if (batch->ball_y[i] < center - 10.f) return INPUT_DOWN;
+    return 0;
+}
+
+static void BotPolicy(const GameBatch* batch, GameInput* inputs, void* user)
+{
+    for (size_t i = 0; i < batch->count; i++)
+    {
+        inputs[i].paddles[0] = BotInputBatch(batch, i, 0);
+        inputs[i].paddles[1] = BotInputBatch(batch, i, 1);
+    }
+}
+
+static unsigned char BotInputFixed(const FixedGameState* state, int paddle)
+{
+    Fixed center = state->paddles[paddle].y + INT_TO_FIXED(50);
+    if (state->ball.y > center + INT_TO_FIXED(10)) return INPUT_UP;
+    if (state->ball.y < center - INT_TO_FIXED(10)) return INPUT_DOWN;
+    return 0;
+}
+
+static void CountWin(HeadlessResult* result, unsigned int score0, unsigned int score1)
+{
+    if (score0 != score1) {
+        result->wins[score1 > score0]++;
+    }
+}
+
+static void RunSequential(const HeadlessOptions* options, HeadlessResult* result)
+{
+    for (unsigned long m = 0; m < options->matches; m++)
+    {
+        GameState state = InitGameState(MatchRng(options->seed, m));
+        unsigned long tick = 0;
+        while (tick < options->max_ticks && state.paddles[0].score < options->points && state.paddles[1].score < options->points)
+        {
+            GameInput input = {{BotInput(&state, 0), BotInput(&state, 1)}};
+            if (options->predictive) {
+                input = (GameInput){{AiInput(&state, 0), AiInput(&state, 1)}};
+            }
+            if (options->swept) {
+                UpdateGameSwept(&state, input);
+            } else {
+                UpdateGame(&state, input);
+            }
+            tick++;
+        }
+        result->ticks += tick;
+        CountWin(result, state.paddles[0].score, state.paddles[1].score);
+    }
+}
+
+static void RunFixed(const HeadlessOptions* options, HeadlessResult* result)
+{
+    result->hash = 0;
+    for (unsigned long m = 0; m < options->matches; m++)
+    {
+        FixedGameState state = InitFixedGameState(MatchRng(options->seed, m));
+        unsigned long tick = 0;
+        while (tick < options->max_ticks && state.paddles[0].score < options->points && state.paddles[1].score < options->points)
+        {
+            // Bots decide every `interval` ticks and hold their input in between
+            GameInput input = {{BotInputFixed(&state, 0), BotInputFixed(&state, 1)}};
+            unsigned long ticks = options->interval;
+            if (ticks > options->max_ticks - tick) ticks = options->max_ticks - tick;
+            if (options->events) {
+                result->stepped += AdvanceGameFixed(&state, input, ticks);
+            } else {
+                for (unsigned long t = 0; t < ticks; t++)
+                {
+                    UpdateGameFixed(&state, input);
+                }
+            }
+            tick += ticks;
+        }
+        result->ticks += tick;
+        CountWin(result, state.paddles[0].score, state.paddles[1].score);
+        result->hash = result->hash * 31 + HashFixedGameState(&state);
+    }
+}
+
+// Plays each match to the end recording quantized snapshots, then times
+// encoding every snapshot against the one snapshot_lag ticks earlier, as a
+// server would for a client whose acks trail by that much, and decoding it back
+static void RunSnapshots(const HeadlessOptions* options, HeadlessResult* result)
+{
+    size_t capacity = 4096;
+    Snapshot* snapshots = malloc(capacity * sizeof(Snapshot));
+    unsigned char* encoded = malloc(capacity * SNAPSHOT_MAX_BYTES);
+    size_t* sizes = malloc(capacity * sizeof(size_t));
+    if (snapshots == NULL || encoded == NULL || sizes == NULL) {
+        free(sizes);
+        free(encoded);
+        free(snapshots);
+        return;
+    }
+
+    for (unsigned long m = 0; m < options->matches; m++)
+    {
+        GameState state = InitGameState(MatchRng(options->seed, m));
+        size_t count = 0;
+        while (count < options->max_ticks && state.paddles[0].score < options->points && state.paddles[1].score < options->points)
+        {
+            GameInput input = {{AiInput(&state, 0), AiInput(&state, 1)}};
+            UpdateGame(&state, input);
+            if (count == capacity) {
+                capacity *= 2;
+                Snapshot* grown_snapshots = realloc(snapshots, capacity * sizeof(Snapshot));
+                if (grown_snapshots != NULL) snapshots = grown_snapshots;
+                unsigned char* grown_encoded = realloc(encoded, capacity * SNAPSHOT_MAX_BYTES);
+                if (grown_encoded != NULL) encoded = grown_encoded;
+                size_t* grown_sizes = realloc(sizes, capacity * sizeof(size_t));
+                if (grown_sizes != NULL) sizes = grown_sizes;
+                if (grown_snapshots == NULL || grown_encoded == NULL || grown_sizes == NULL) {
+                    free(sizes);
+                    free(encoded);
+                    free(snapshots);
+                    return;
+                }
+            }
+            snapshots[count] = QuantizeGameState(&state, (uint32_t)count + 1);
+            count++;
+        }
+        result->ticks += count;
+        CountWin(result, state.paddles[0].score, state.paddles[1].score);
+
+        double start = GetSeconds();
+        for (size_t t = 0; t < count; t++)
+        {
+            const Snapshot* baseline = t >= options->snapshot_lag ? &snapshots[t - options->snapshot_lag] : NULL;
+            sizes[t] = EncodeSnapshot(&snapshots[t], baseline, encoded + t * SNAPSHOT_MAX_BYTES, SNAPSHOT_MAX_BYTES);
+        }
+        for (size_t t = 0; t < count; t++)
+        {
+            const unsigned char* data = encoded + t * SNAPSHOT_MAX_BYTES;
+            uint32_t distance;
+            Snapshot decoded;
+            if (!ReadSnapshotBaseline(data, sizes[t], &distance) || distance > t ||
+                !DecodeSnapshot(data, sizes[t], (uint32_t)t + 1, distance > 0 ? &snapshots[t - distance] : NULL, &decoded) ||
+                memcmp(&decoded, &snapshots[t], sizeof(Snapshot)) != 0) {
+                result->mismatches++;
+            }
+        }
+        result->snapshot_seconds += GetSeconds() - start;
+
+        for (size_t t = 0; t < count; t++)
+        {
+            result->snapshot_bytes += sizes[t];
+            if (t < options->snapshot_lag) {
+                result->full_snapshots++;
+                result->full_bytes += sizes[t];
+            }
+        }
+        result->snapshots += count;
+    }
+
+    free(sizes);
+    free(encoded);
+    free(snapshots);
+}
+
+static size_t CompareBatches(const GameBatch* a, const GameBatch* b)
+{
+    size_t bytes = a->count * sizeof(float);
+    size_t mismatches = 0;
+    mismatches += memcmp(a->ball_x, b->ball_x, bytes) != 0;
+    mismatches += memcmp(a->ball_y, b->ball_y, bytes) != 0;
+    mismatches += memcmp(a->ball_vx, b->ball_vx, bytes) != 0;
+    mismatches += memcmp(a->ball_vy, b->ball_vy, bytes) != 0;
+    for (int p = 0; p < 2; p++)
+    {
+        mismatches += memcmp(a->paddle_y[p], b->paddle_y[p], bytes) != 0;
+        mismatches += memcmp(a->paddle_vy[p], b->paddle_vy[p], bytes) != 0;
+        mismatches += memcmp(a->score[p], b->score[p], a->count * sizeof(unsigned int)) != 0;
+    }
+    mismatches += memcmp(a->rng, b->rng, a->count * sizeof(uint64_t)) != 0;
+
+    return mismatches;
+}
+
+static void RunBatched(const HeadlessOptions* options, HeadlessResult* result)
+{
+    GameBatch batch = CreateGameBatch(options->batch_size);
+    GameBatch reference = CreateGameBatch(options->verify ? options->batch_size : 0);
+    GameInput* inputs = (GameInput*)malloc(options->batch_size * sizeof(GameInput));
+    if (batch.memory == NULL || reference.memory == NULL || inputs == NULL) {
+        free(inputs);
+        DestroyGameBatch(&reference);
+        DestroyGameBatch(&batch);
+        return;
+    }
+
+    unsigned long started = 0;
+    while (started < options->matches)
+    {
+        while (batch.count < batch.capacity && started < options->matches)
+        {
+            GameBatchAdd(&batch, InitGameState(MatchRng(options->seed, started)));
+            started++;
+        }
+
+        // Every match in the batch started together, so they share a tick count
+        for (unsigned long tick = 0; tick < options->max_ticks && batch.count > 0; tick++)
+        {
+            if (options->predictive) {
+                AiPolicy(&batch, inputs, NULL);
+            } else {
+                BotPolicy(&batch, inputs, NULL);
+            }
+            if (options->verify) {
+                for (size_t i = 0; i < batch.count; i++)
+                {
+                    GameBatchSet(&reference, i, GameBatchGet(&batch, i));
+                }
+                reference.count = batch.count;
+                StepGameBatchScalar(&reference, inputs);
+                StepGameBatch(&batch, inputs);
+                result->mismatches += CompareBatches(&batch, &reference);
+            } else {
+                StepGameBatch(&batch, inputs);
+            }
+            result->ticks += batch.count;
+
+            for (size_t i = batch.count; i-- > 0;)
+            {
+                if (batch.score[0][i] >= options->points || batch.score[1][i] >= options->points) {
+                    CountWin(result, batch.score[0][i], batch.score[1][i]);
+                    GameBatchRemove(&batch, i);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < batch.count; i++)
+        {
+            CountWin(result, batch.score[0][i], batch.score[1][i]);
+        }
+        batch.count = 0;
+    }
+
+    free(inputs);
+    DestroyGameBatch(&reference);
+    DestroyGameBatch(&batch);
+}
+
+static void RunThreaded(const HeadlessOptions* options, HeadlessResult* result)
+{
+    RunnerOptions runner_options;
+    memset(&runner_options, 0, sizeof(runner_options));
+    runner_options.matches = options->matches;
+    runner_options.points = options->points;
+    runner_options.max_ticks = options->max_ticks;
+    runner_options.seed = options->seed;
+    runner_options.threads = options->threads;
+    runner_options.chunk_size = options->batch_size;
+    runner_options.policy = options->predictive ? AiPolicy : BotPolicy;
+
+    RunnerResult runner_result = RunMatches(runner_options);
+    result->ticks = runner_result.ticks;
+    result->wins[0] = runner_result.wins[0];
+    result->wins[1] = runner_result.wins[1];
+
+    for (unsigned int t = 0; t < runner_result.threads; t++)
+    {
+        RunnerThreadStats* stats = &runner_result.thread_stats[t];
+        printf("thread %u: %llu ticks, %lu tasks, %lu steals, %.1f%% busy\n", t, stats->ticks, stats->tasks, stats->steals,
+               runner_result.seconds > 0.0 ? 100.0 * stats->busy_seconds / runner_result.seconds : 0.0);
+    }
+    FreeRunnerResult(&runner_result);
+}
+
+static int ParseKernel(const char* name, BatchKernel* kernel)
+{
+    for (int k = BATCH_KERNEL_AUTO; k <= BATCH_KERNEL_NEON; k++)
+    {
+        if (strcmp(name, BatchKernelName((BatchKernel)k)) == 0) {
+            *kernel = (BatchKernel)k;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void Usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [-n matches] [-p points] [-t max_ticks] [-s seed] [-b batch_size]\n"
+                    "       [-k auto|scalar|sse|avx2|neon] [-v] [-j threads] [-x] [-c]\n"
+                    "       [-e] [-i decision_interval] [-a] [-z snapshot_lag]\n", name);
+}
+
+// Each mode reads only some of the flags; reject combinations it would ignore
+static const char* ModeConflict(const HeadlessOptions* options)
+{
+    int batched = options->batch_size > 0 || options->threads > 0;
+    if (options->snapshot_lag > 0 && (options->fixed || options->swept || options->predictive || batched)) {
+        return "-z cannot be combined with -x, -e, -c, -a, -b or -j";
+    }
+    if (options->fixed && (options->swept || options->predictive || batched)) {
+        return "-x and -e cannot be combined with -c, -a, -b or -j";
+    }
+    if (options->swept && batched) return "-c cannot be combined with -b or -j";
+    if (options->verify && (options->batch_size == 0 || options->threads > 0)) return "-v needs -b and cannot be combined with -j";
+    if (options->interval != 1 && !options->fixed) return "-i needs -x or -e";
+    if (options->kernel != BATCH_KERNEL_AUTO && !batched) return "-k needs -b or -j";
+    return NULL;
+}
+
+static int ParseOptions(int argc, char** argv, HeadlessOptions* options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0) {
+            options->verify = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-x") == 0) {
+            options->fixed = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-c") == 0) {
+            options->swept = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-a") == 0) {
+            options->predictive = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-e") == 0) {
+            options->fixed = 1;
+            options->events = 1;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            Usage(argv[0]);
+            return 0;
+        }
+        const char* value = argv[++i];
+        if (strcmp(argv[i-1], "-n") == 0) {
+            options->matches = strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-p") == 0) {
+            options->points = (unsigned int)strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-t") == 0) {
+            options->max_ticks = strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-s") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-b") == 0) {
+            options->batch_size = strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-i") == 0) {
+            options->interval = strtoul(value, NULL, 10);
+            if (options->interval == 0) options->interval = 1;
+        } else if (strcmp(argv[i-1], "-z") == 0) {
+            options->snapshot_lag = strtoul(value, NULL, 10);
+            if (options->snapshot_lag == 0) options->snapshot_lag = 1;
+        } else if (strcmp(argv[i-1], "-j") == 0) {
+            options->threads = (unsigned int)strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-k") == 0) {
+            if (!ParseKernel(value, &options->kernel)) {
+                Usage(argv[0]);
+                return 0;
+            }
+        } else {
+            Usage(argv[0]);
+            return 0;
+        }
+    }
+
+    const char* conflict = ModeConflict(options);
+    if (conflict != NULL) {
+        fprintf(stderr, "%s\n", conflict);
+        Usage(argv[0]);
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    HeadlessOptions options = {1000, 11, 100000, 0, 0, BATCH_KERNEL_AUTO, 0, 0, 0, 0, 0, 1, 0, 0};
+    if (!ParseOptions(argc, argv, &options)) return 1;
+    if (!SetBatchKernel(options.kernel)) {
+        fprintf(stderr, "Kernel not supported on this CPU: %s\n", BatchKernelName(options.kernel));
+        return 1;
+    }
+
+    HeadlessResult result = {0, {0, 0}, 0, 0, 0, 0, 0, 0, 0, 0.0};
+    double start = GetSeconds();
+
+    if (options.snapshot_lag > 0) {
+        RunSnapshots(&options, &result);
+    } else if (options.fixed) {
+        RunFixed(&options, &result);
+    } else if (options.threads > 0) {
+        RunThreaded(&options, &result);
+    } else if (options.batch_size > 0) {
+        RunBatched(&options, &result);
+    } else {
+        RunSequential(&options, &result);
+    }
+
+    double elapsed = GetSeconds() - start;
+    if (options.snapshot_lag > 0) {
+        printf("mode: snapshot encoding, baseline %lu ticks back\n", options.snapshot_lag);
+    } else if (options.events) {
+        printf("mode: fixed-point, event-driven\n");
+    } else if (options.fixed) {
+        printf("mode: fixed-point\n");
+    } else if (options.swept && options.batch_size == 0 && options.threads == 0) {
+        printf("mode: swept collision\n");
+    } else if (options.batch_size > 0 || options.threads > 0) {
+        printf("kernel: %s\n", BatchKernelName(GetBatchKernel()));
+    }
+    printf("matches: %lu\n", options.matches);
+    printf("wins: %lu - %lu\n", result.wins[0], result.wins[1]);
+    printf("ticks: %llu\n", result.ticks);
+    printf("time: %.3f s\n", elapsed);
+    printf("ticks/sec: %.0f\n", elapsed > 0.0 ? (double)result.ticks / elapsed : 0.0);
+    if (options.fixed) {
+        printf("hash: %016llx\n", (unsigned long long)result.hash);
+    }
+    if (options.events) {
+        printf("stepped ticks: %llu\n", result.stepped);
+    }
+    if (options.snapshot_lag > 0) {
+        unsigned long long deltas = result.snapshots - result.full_snapshots;
+        printf("snapshots: %llu (%llu full)\n", result.snapshots, result.full_snapshots);
+        printf("bytes/snapshot: %.2f average, %.2f per delta\n", result.snapshots > 0 ? (double)result.snapshot_bytes / result.snapshots : 0.0,
+               deltas > 0 ? (double)(result.snapshot_bytes - result.full_bytes) / deltas : 0.0);
+        printf("snapshots/sec: %.0f (encode and decode)\n", result.snapshot_seconds > 0.0 ? (double)result.snapshots / result.snapshot_seconds : 0.0);
+        printf("mismatches: %llu\n", result.mismatches);
+    }
+    if (options.verify) {
+        printf("mismatches: %llu\n", result.mismatches);
+    }
+
+    return result.mismatches == 0 ? 0 : 1;
+}
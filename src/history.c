@@ -0,0 +1,69 @@
+#include "history.h"
+#include <string.h>
+#include "replay.h"
+
+void InitGameHistory(GameHistory* history)
+{
+    history->newest = 0;
+    history->count = 0;
+}
+
+static inline uint32_t OldestTick(const GameHistory* history)
+{
+    return history->newest - (history->count - 1);
+}
+
+int HasGameState(const GameHistory* history, uint32_t tick)
+{
+    // Unsigned distance back from the newest tick, so ticks past it fail too
+    return history->count > 0 && history->newest - tick < history->count;
+}
+
+void SaveGameState(GameHistory* history, uint32_t tick, const GameState* state, GameInput input)
+{
+    if (history->count > 0 && HasGameState(history, tick)) {
+        // Rewriting the past: later ticks belong to the old timeline
+        history->count -= history->newest - tick;
+    } else if (history->count > 0 && tick == history->newest + 1) {
+        if (history->count < HISTORY_SIZE) history->count++;
+    } else {
+        history->count = 1;
+    }
+    history->newest = tick;
+
+    uint32_t slot = tick & (HISTORY_SIZE - 1);
+    history->states[slot] = *state;
+    history->inputs[slot] = input;
+}
+
+int LoadGameState(const GameHistory* history, uint32_t tick, GameState* state)
+{
+    if (!HasGameState(history, tick)) return 0;
+    *state = history->states[tick & (HISTORY_SIZE - 1)];
+    return 1;
+}
+
+GameInput GetHistoryInput(const GameHistory* history, uint32_t tick)
+{
+    return history->inputs[tick & (HISTORY_SIZE - 1)];
+}
+
+size_t EncodeGameHistory(const GameHistory* history, unsigned char* out)
+{
+    if (history->count == 0) return 0;
+
+    uint32_t oldest = OldestTick(history);
+    const GameState* first = &history->states[oldest & (HISTORY_SIZE - 1)];
+
+    uint32_t runs[HISTORY_SIZE];
+    unsigned char keyframes[(HISTORY_SIZE / REPLAY_DEFAULT_KEYFRAME_INTERVAL + 1) * REPLAY_KEYFRAME_SIZE];
+    ReplayWriter writer;
+    InitReplayWriterInto(&writer, first->rng, REPLAY_DEFAULT_KEYFRAME_INTERVAL, 0,
+                         runs, HISTORY_SIZE, keyframes, HISTORY_SIZE / REPLAY_DEFAULT_KEYFRAME_INTERVAL + 1);
+    for (uint32_t i = 0; i < history->count; i++)
+    {
+        uint32_t slot = (oldest + i) & (HISTORY_SIZE - 1);
+        RecordReplayTick(&writer, &history->states[slot], history->inputs[slot]);
+    }
+    return EncodeReplay(&writer, out);
+}
@@ -0,0 +1,70 @@
+#include "input.h"
+#include <string.h>
+
+void InitInputQueue(InputQueue* queue)
+{
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    memset(queue->events, 0, sizeof(queue->events));
+}
+
+int PushInputEvent(InputQueue* queue, InputEvent event)
+{
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head >= INPUT_QUEUE_SIZE) return 0;
+
+    queue->events[tail & (INPUT_QUEUE_SIZE - 1)] = event;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+int PeekInputEvent(InputQueue* queue, InputEvent* event)
+{
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail) return 0;
+
+    *event = queue->events[head & (INPUT_QUEUE_SIZE - 1)];
+    return 1;
+}
+
+int PopInputEvent(InputQueue* queue, InputEvent* event)
+{
+    if (!PeekInputEvent(queue, event)) return 0;
+
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return 1;
+}
+
+GameInput DrainInputQueue(InputQueue* queue, InputState* state, double tick_end, double now)
+{
+    InputEvent event;
+    while (PeekInputEvent(queue, &event) && event.time < tick_end)
+    {
+        PopInputEvent(queue, &event);
+        if (event.paddle > 1) continue;
+
+        if (event.pressed) {
+            state->held[event.paddle] |= event.button;
+            state->tapped[event.paddle] |= event.button;
+
+            double latency = now - event.time;
+            state->latency_sum += latency;
+            if (latency > state->latency_max) state->latency_max = latency;
+            state->latency_count++;
+        } else {
+            state->held[event.paddle] &= ~event.button;
+        }
+    }
+
+    GameInput input;
+    for (int p = 0; p < 2; p++)
+    {
+        input.paddles[p] = state->held[p] | state->tapped[p];
+        state->tapped[p] = 0;
+    }
+
+    return input;
+}
@@ -0,0 +1,130 @@
+#include "jitter.h"
+#include <math.h>
+
+#define SNAP_DISTANCE 100.f // ball moves further between snapshots only when it is served again
+
+void InitJitterBuffer(JitterBuffer* buffer, double tick_time)
+{
+    InitSnapshotHistory(&buffer->snapshots);
+    buffer->newest = 0;
+    buffer->tick_time = tick_time;
+    buffer->transit = 0.0;
+    buffer->jitter = 0.0;
+    buffer->spacing = 1.0;
+    buffer->offset = 0.0;
+    buffer->last_sample = -1.0;
+    JitterStats stats = {0, 0, 0, 0, 0, 0};
+    buffer->stats = stats;
+}
+
+double JitterBufferDelay(const JitterBuffer* buffer)
+{
+    return buffer->spacing * buffer->tick_time + JITTER_DEVIATIONS * buffer->jitter;
+}
+
+void PushJitterSnapshot(JitterBuffer* buffer, const Snapshot* snapshot, double arrival)
+{
+    if (buffer->newest != 0 && (snapshot->tick + SNAPSHOT_HISTORY <= buffer->newest || FindSnapshot(&buffer->snapshots, snapshot->tick) != NULL)) {
+        buffer->stats.dropped++;
+        return;
+    }
+    buffer->stats.received++;
+    if (buffer->last_sample >= 0.0 && snapshot->tick <= (arrival - buffer->offset) / buffer->tick_time) buffer->stats.late++;
+
+    double transit = arrival - snapshot->tick * buffer->tick_time;
+    if (buffer->newest == 0) {
+        buffer->transit = transit;
+        buffer->newest = snapshot->tick;
+    } else {
+        buffer->jitter += (fabs(transit - buffer->transit) - buffer->jitter) / 16.0;
+        buffer->transit += (transit - buffer->transit) / 16.0;
+        if (snapshot->tick > buffer->newest) {
+            buffer->spacing += ((double)(snapshot->tick - buffer->newest) - buffer->spacing) / 16.0;
+            buffer->newest = snapshot->tick;
+        }
+    }
+    StoreSnapshot(&buffer->snapshots, snapshot);
+}
+
+static float Lerp(float a, float b, float t)
+{
+    return a + (b - a) * t;
+}
+
+static void Extrapolate(GameState* state, float ticks)
+{
+    state->ball.position.x += state->ball.velocity.x * ticks;
+    state->ball.position.y += state->ball.velocity.y * ticks;
+    state->ball = CheckBallWallCollision(state->ball);
+    for (int p = 0; p < 2; p++)
+    {
+        state->paddles[p].position.y += state->paddles[p].velocity.y * ticks;
+        state->paddles[p] = CheckPaddleCollision(state->paddles[p]);
+    }
+}
+
+int SampleJitterBuffer(JitterBuffer* buffer, double now, GameState* state, double* tick)
+{
+    if (buffer->newest == 0) return 0;
+
+    // Slew toward the target offset rather than jump, so the match never
+    // visibly skips or runs backwards while the delay adapts
+    double target = buffer->transit + JitterBufferDelay(buffer);
+    if (buffer->last_sample < 0.0) {
+        buffer->offset = target;
+    } else {
+        double limit = JITTER_SLEW * (now - buffer->last_sample);
+        double change = target - buffer->offset;
+        buffer->offset += change > limit ? limit : change < -limit ? -limit : change;
+    }
+    buffer->last_sample = now;
+
+    double playout = (now - buffer->offset) / buffer->tick_time;
+    if (tick != NULL) *tick = playout;
+
+    // The snapshots either side of the playout tick
+    const Snapshot* before = NULL;
+    const Snapshot* after = NULL;
+    uint32_t oldest = buffer->newest >= SNAPSHOT_HISTORY ? buffer->newest - SNAPSHOT_HISTORY + 1 : 1;
+    uint32_t base = playout < oldest ? oldest - 1 : playout >= buffer->newest ? buffer->newest : (uint32_t)playout;
+    for (uint32_t t = base; t >= oldest && before == NULL; t--)
+    {
+        before = FindSnapshot(&buffer->snapshots, t);
+    }
+    for (uint32_t t = base + 1; t <= buffer->newest && after == NULL; t++)
+    {
+        after = FindSnapshot(&buffer->snapshots, t);
+    }
+
+    if (before == NULL) {
+        *state = DequantizeSnapshot(after);
+        buffer->stats.held++;
+        return 1;
+    }
+    *state = DequantizeSnapshot(before);
+
+    if (after == NULL) {
+        double ahead = playout - before->tick;
+        if (ahead > JITTER_MAX_EXTRAPOLATION) {
+            ahead = JITTER_MAX_EXTRAPOLATION;
+            buffer->stats.held++;
+        } else {
+            buffer->stats.extrapolated++;
+        }
+        Extrapolate(state, (float)ahead);
+        return 1;
+    }
+
+    GameState next = DequantizeSnapshot(after);
+    float t = (float)((playout - before->tick) / (after->tick - before->tick));
+    if (fabsf(next.ball.position.x - state->ball.position.x) < SNAP_DISTANCE) {
+        state->ball.position.x = Lerp(state->ball.position.x, next.ball.position.x, t);
+        state->ball.position.y = Lerp(state->ball.position.y, next.ball.position.y, t);
+    }
+    for (int p = 0; p < 2; p++)
+    {
+        state->paddles[p].position.y = Lerp(state->paddles[p].position.y, next.paddles[p].position.y, t);
+    }
+    buffer->stats.interpolated++;
+    return 1;
+}
@@ -0,0 +1,579 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "game.h"
+#include "ai.h"
+#include "net.h"
+#include "protocol.h"
+#include "snapshot.h"
+
+// Load generator for pong-server, every client on its own UDP socket so the
+// server sees them as separate players.
+//
+// Spectators (-n) all watch one match and report the frames they decode,
+// and how far apart in time the copies of one frame reach them. -T records
+// the first spectator's arrivals as a pong-playout trace.
+//
+// Bots (-b) join and play matches: on each state a bot runs the simulation
+// half a round trip ahead and picks its input with AiInput. Bots start -i
+// at a time, one stage every -d seconds, and each stage reports how long
+// joins took, how long a press took to show in the states, and how late
+// the states arrived. That lateness is client-observed: arrival past the
+// bot's fastest transit, so it includes loadgen's own delays, which the
+// loop line reports as the time spent handling each epoll batch. With -c
+// the exit status checks matchmaking: it fails unless every bot got into a
+// match (all but one for an odd count), e.g. against pong-server -j 8.
+
+#define EPOLL_BATCH 256
+#define JOIN_RETRY 0.2          // seconds between MSG_JOIN while waiting for a match
+#define INPUT_INTERVAL 2        // states between MSG_INPUT while the buttons are unchanged
+#define MAX_LEAD 8              // ticks a bot predicts ahead at most
+#define PRESSED_VY (10 * SNAPSHOT_VELOCITY_SCALE)   // paddle velocity while a button is held
+
+typedef struct LoadOptions {
+    NetAddress server;
+    unsigned long spectators;
+    uint32_t match_id;
+    double duration;            // seconds, per stage when there are bots
+    const char* trace;
+    unsigned long bots;
+    unsigned long increment;    // bots started per stage, 0 for all at once
+    int check;                  // fail unless every bot got a match
+} LoadOptions;
+
+typedef struct SpectatorClient {
+    int socket;
+    double last_watch;
+    SnapshotHistory history;
+} SpectatorClient;
+
+typedef struct LoadStats {
+    unsigned long long frames;
+    unsigned long long bytes;
+    unsigned long long full;
+    unsigned long long missing_baseline;    // deltas dropped until the next full snapshot
+    unsigned long long invalid;
+    double max_spread;      // latest minus earliest arrival of one frame
+} LoadStats;
+
+typedef enum BotPhase {
+    BOT_IDLE,       // not started yet
+    BOT_JOINING,
+    BOT_PLAYING,
+} BotPhase;
+
+typedef struct BotClient {
+    int socket;
+    BotPhase phase;
+    int matched;            // got into a match at least once
+    double join_start;      // first MSG_JOIN of this attempt
+    double last_join;
+    uint32_t match_id;
+    unsigned char paddle;
+    unsigned char buttons;
+    uint32_t ack;
+    unsigned long states;
+    double pressed_at;      // a press no state shows yet, 0 for none
+    int16_t last_vy;        // our paddle's velocity in the previous state
+    double rtt;             // smoothed press round trip, sets the prediction lead
+    double min_transit;     // fastest arrival minus tick time so far
+    SnapshotHistory history;
+} BotClient;
+
+// Raw samples of one stage, sorted for exact percentiles when it ends
+typedef struct Samples {
+    float* values;
+    size_t count;
+    size_t capacity;
+} Samples;
+
+typedef struct BotStats {
+    Samples connect;
+    Samples input_rtt;
+    Samples lateness;       // state arrival past the bot's fastest transit
+    Samples loop;           // loadgen's handling time of each epoll batch
+    double busy;            // sum of loop
+    unsigned long long states;
+    unsigned long long bytes;
+    unsigned long long missing_baseline;
+    unsigned long matches;          // finished
+} BotStats;
+
+static volatile sig_atomic_t load_stop;
+
+static void StopLoad(int sig)
+{
+    load_stop = 1;
+}
+
+static double GetSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void AddSample(Samples* samples, double value)
+{
+    if (samples->count == samples->capacity) {
+        size_t capacity = samples->capacity > 0 ? samples->capacity * 2 : 1024;
+        float* values = realloc(samples->values, capacity * sizeof(float));
+        if (values == NULL) return;
+        samples->values = values;
+        samples->capacity = capacity;
+    }
+    samples->values[samples->count++] = (float)value;
+}
+
+static int CompareSamples(const void* a, const void* b)
+{
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank over the sorted samples, so no bound exceeds the max
+static double SamplePercentile(const Samples* samples, double fraction)
+{
+    if (samples->count == 0) return 0.0;
+    size_t rank = (size_t)(fraction * samples->count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > samples->count) rank = samples->count;
+    return samples->values[rank - 1];
+}
+
+static void ClearStats(BotStats* stats)
+{
+    Samples* samples[] = {&stats->connect, &stats->input_rtt, &stats->lateness, &stats->loop};
+    for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++)
+    {
+        samples[i]->count = 0;
+    }
+    stats->busy = 0.0;
+    stats->states = 0;
+    stats->bytes = 0;
+    stats->missing_baseline = 0;
+    stats->matches = 0;
+}
+
+static void FreeStats(BotStats* stats)
+{
+    free(stats->connect.values);
+    free(stats->input_rtt.values);
+    free(stats->lateness.values);
+    free(stats->loop.values);
+}
+
+static void SendWatch(const LoadOptions* options, SpectatorClient* client, double now)
+{
+    unsigned char packet[PROTOCOL_MAX_MESSAGE];
+    size_t size = WriteWatchMessage(packet, options->match_id);
+    SendPacket(client->socket, &options->server, packet, size);
+    client->last_watch = now;
+}
+
+static void ReceiveFrames(SpectatorClient* client, LoadStats* stats, uint32_t* newest_tick, double* first_arrival, FILE* trace, double now)
+{
+    unsigned char packet[NET_MAX_PACKET];
+    int size;
+    while ((size = ReceivePacket(client->socket, NULL, packet, sizeof(packet))) > 0)
+    {
+        StateMessage message;
+        uint32_t distance;
+        if (!ReadStateMessage(packet, (size_t)size, &message) ||
+            !ReadSnapshotBaseline(message.snapshot, message.snapshot_size, &distance)) {
+            stats->invalid++;
+            continue;
+        }
+
+        const Snapshot* baseline = NULL;
+        if (distance > 0) {
+            baseline = FindSnapshot(&client->history, message.tick - distance);
+            if (baseline == NULL) {
+                stats->missing_baseline++;
+                continue;
+            }
+        }
+        Snapshot snapshot;
+        if (!DecodeSnapshot(message.snapshot, message.snapshot_size, message.tick, baseline, &snapshot)) {
+            stats->invalid++;
+            continue;
+        }
+        // A full snapshot may start a new match on the slot, with ticks from 1 again
+        if (baseline == NULL) {
+            InitSnapshotHistory(&client->history);
+            stats->full++;
+        }
+        StoreSnapshot(&client->history, &snapshot);
+        if (trace != NULL) fprintf(trace, "%u %.6f\n", message.tick, now);
+        stats->frames++;
+        stats->bytes += (unsigned long long)size;
+
+        if (message.tick != *newest_tick) {
+            *newest_tick = message.tick;
+            *first_arrival = now;
+        } else if (now - *first_arrival > stats->max_spread) {
+            stats->max_spread = now - *first_arrival;
+        }
+    }
+}
+
+static void SendJoin(const LoadOptions* options, BotClient* bot, double now)
+{
+    unsigned char packet[PROTOCOL_MAX_MESSAGE];
+    SendPacket(bot->socket, &options->server, packet, WriteJoinMessage(packet));
+    if (bot->phase != BOT_JOINING) {
+        bot->phase = BOT_JOINING;
+        bot->join_start = now;
+        bot->buttons = 0;
+        bot->ack = 0;
+        bot->states = 0;
+        bot->pressed_at = 0.0;
+        InitSnapshotHistory(&bot->history);
+    }
+    bot->last_join = now;
+}
+
+// The server is about half a round trip past the newest state by the time
+// our input reaches it, so decide for where the match will be by then
+static void PlayBot(const LoadOptions* options, BotClient* bot, const Snapshot* snapshot, double now)
+{
+    GameState state = DequantizeSnapshot(snapshot);
+    int lead = (int)(bot->rtt * 30.0) + 1;
+    if (lead > MAX_LEAD) lead = MAX_LEAD;
+    for (int t = 0; t < lead; t++)
+    {
+        GameInput input = {{0, 0}};
+        input.paddles[bot->paddle] = bot->buttons;
+        UpdateGame(&state, input);
+    }
+
+    unsigned char buttons = AiInput(&state, bot->paddle);
+    // Time the newest press, unless the paddle already moves that way and
+    // its arrival cannot be told apart; a release before it shows cancels it
+    if (buttons != bot->buttons) {
+        int16_t vy = buttons & INPUT_UP ? PRESSED_VY : buttons & INPUT_DOWN ? -PRESSED_VY : 0;
+        bot->pressed_at = buttons != 0 && bot->last_vy != vy ? now : 0.0;
+    }
+    if (buttons != bot->buttons || bot->states % INPUT_INTERVAL == 0) {
+        bot->buttons = buttons;
+        unsigned char packet[PROTOCOL_MAX_MESSAGE];
+        InputMessage message = {bot->match_id, bot->paddle, bot->buttons, bot->ack, bot->ack};
+        SendPacket(bot->socket, &options->server, packet, WriteInputMessage(packet, &message));
+    }
+}
+
+static void ReceiveStates(const LoadOptions* options, BotClient* bot, BotStats* stats, double now)
+{
+    unsigned char packet[NET_MAX_PACKET];
+    int size;
+    while ((size = ReceivePacket(bot->socket, NULL, packet, sizeof(packet))) > 0)
+    {
+        StateMessage message;
+        uint32_t distance;
+        if (bot->phase == BOT_IDLE || !ReadStateMessage(packet, (size_t)size, &message) || message.paddle > 1 ||
+            !ReadSnapshotBaseline(message.snapshot, message.snapshot_size, &distance)) {
+            continue;
+        }
+        // States of a match left behind may still be in flight; a new one
+        // starts with a full snapshot, as nothing of it has been acked
+        if (bot->phase == BOT_PLAYING ? message.match_id != bot->match_id : distance > 0) continue;
+
+        const Snapshot* baseline = NULL;
+        if (distance > 0) {
+            baseline = FindSnapshot(&bot->history, message.tick - distance);
+            if (baseline == NULL) {
+                stats->missing_baseline++;
+                continue;
+            }
+        }
+        Snapshot snapshot;
+        if (!DecodeSnapshot(message.snapshot, message.snapshot_size, message.tick, baseline, &snapshot)) continue;
+        StoreSnapshot(&bot->history, &snapshot);
+        stats->states++;
+        stats->bytes += (unsigned long long)size;
+
+        double transit = now - message.tick / 60.0;
+        int16_t vy = snapshot.paddle_vy[message.paddle];
+        if (bot->phase == BOT_JOINING) {
+            AddSample(&stats->connect, now - bot->join_start);
+            bot->phase = BOT_PLAYING;
+            bot->matched = 1;
+            bot->match_id = message.match_id;
+            bot->paddle = message.paddle;
+            bot->min_transit = transit;
+            bot->last_vy = vy;
+        }
+
+        // On localhost the transit barely varies, so anything above the
+        // fastest one is the server ticking late or a socket queueing
+        if (transit < bot->min_transit) bot->min_transit = transit;
+        AddSample(&stats->lateness, transit - bot->min_transit);
+
+        // Holding a button sets the paddle's velocity to exactly +-10
+        int16_t pressed_vy = bot->buttons & INPUT_UP ? PRESSED_VY : bot->buttons & INPUT_DOWN ? -PRESSED_VY : 0;
+        if (bot->pressed_at > 0.0 && pressed_vy != 0 && vy == pressed_vy) {
+            double rtt = now - bot->pressed_at;
+            AddSample(&stats->input_rtt, rtt);
+            bot->rtt = bot->rtt == 0.0 ? rtt : bot->rtt + (rtt - bot->rtt) / 8.0;
+            bot->pressed_at = 0.0;
+        }
+        bot->last_vy = vy;
+
+        if (message.tick > bot->ack) bot->ack = message.tick;
+        bot->states++;
+        if (message.flags & STATE_FINISHED) {
+            stats->matches++;
+            SendJoin(options, bot, now);
+        } else {
+            PlayBot(options, bot, &snapshot, now);
+        }
+    }
+}
+
+static void PrintSamples(const char* name, const char* unit, Samples* samples)
+{
+    qsort(samples->values, samples->count, sizeof(float), CompareSamples);
+    printf("  %-10s %zu %s, p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", name, samples->count, unit,
+           SamplePercentile(samples, 0.5) * 1e3, SamplePercentile(samples, 0.99) * 1e3, SamplePercentile(samples, 1.0) * 1e3);
+}
+
+static void PrintStage(const BotClient* bots, unsigned long started, BotStats* stats, double interval)
+{
+    unsigned long playing = 0;
+    for (unsigned long b = 0; b < started; b++)
+    {
+        playing += bots[b].phase == BOT_PLAYING;
+    }
+    printf("bots: %lu (%lu playing), states/s: %.0f, kB/s: %.1f, matches finished: %lu, missing baseline: %llu\n",
+           started, playing, stats->states / interval, stats->bytes / interval / 1000.0, stats->matches, stats->missing_baseline);
+    PrintSamples("connect:", "joins", &stats->connect);
+    PrintSamples("input rtt:", "presses", &stats->input_rtt);
+    PrintSamples("lateness:", "states (client-observed)", &stats->lateness);
+    PrintSamples("loop:", "batches", &stats->loop);
+    printf("  %-10s %.1f%% of the stage\n", "busy:", stats->busy / interval * 100.0);
+    fflush(stdout);
+}
+
+static void Usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [-H host:port] [-n spectators] [-w match_id] [-T trace]\n"
+                    "       [-b bots] [-i bots_per_stage] [-d seconds] [-c]\n", name);
+}
+
+static int ParseOptions(int argc, char** argv, LoadOptions* options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-c") == 0) {
+            options->check = 1;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            Usage(argv[0]);
+            return 0;
+        }
+        const char* value = argv[++i];
+        if (strcmp(argv[i-1], "-H") == 0) {
+            if (!ParseNetAddress(value, &options->server)) {
+                Usage(argv[0]);
+                return 0;
+            }
+        } else if (strcmp(argv[i-1], "-n") == 0) {
+            options->spectators = strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-w") == 0) {
+            options->match_id = (uint32_t)strtoul(value, NULL, 0);
+        } else if (strcmp(argv[i-1], "-d") == 0) {
+            options->duration = strtod(value, NULL);
+        } else if (strcmp(argv[i-1], "-T") == 0) {
+            options->trace = value;
+        } else if (strcmp(argv[i-1], "-b") == 0) {
+            options->bots = strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-i") == 0) {
+            options->increment = strtoul(value, NULL, 10);
+        } else {
+            Usage(argv[0]);
+            return 0;
+        }
+    }
+    if (options->bots > 0 && options->duration <= 0.0) {
+        Usage(argv[0]);
+        return 0;
+    }
+
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    LoadOptions options = {{0x7f000001, 7777}, 0, 0, 10.0, NULL, 0, 0, 0};
+    if (!ParseOptions(argc, argv, &options)) return 1;
+    if (options.spectators == 0 && options.bots == 0) options.spectators = 1000;
+    if (options.increment == 0 || options.increment > options.bots) options.increment = options.bots;
+
+    // One descriptor per client
+    unsigned long clients = options.spectators + options.bots;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < clients + 16) {
+        limit.rlim_cur = clients + 16 < limit.rlim_max ? clients + 16 : limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    SpectatorClient* spectators = calloc(options.spectators + 1, sizeof(SpectatorClient));
+    BotClient* bots = calloc(options.bots + 1, sizeof(BotClient));
+    int epoll = epoll_create1(0);
+    FILE* trace = options.trace != NULL ? fopen(options.trace, "w") : NULL;
+    if (spectators == NULL || bots == NULL || epoll < 0 || (options.trace != NULL && trace == NULL)) return 1;
+
+    // Epoll data is the client index: spectators first, then bots
+    for (unsigned long c = 0; c < clients; c++)
+    {
+        int socket = OpenUdpSocket(0);
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = c;
+        if (socket < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, socket, &event) != 0) {
+            fprintf(stderr, "Failed to open client socket %lu\n", c);
+            return 1;
+        }
+        if (c < options.spectators) {
+            spectators[c].socket = socket;
+        } else {
+            bots[c - options.spectators].socket = socket;
+        }
+    }
+
+    double start = GetSeconds();
+    for (unsigned long c = 0; c < options.spectators; c++)
+    {
+        SpectatorClient* client = &spectators[c];
+        InitSnapshotHistory(&client->history);
+        SendWatch(&options, client, start);
+        // Spread the keepalives over the interval, in client order
+        client->last_watch = start + SPECTATOR_KEEPALIVE * (double)c / options.spectators;
+    }
+
+    signal(SIGINT, StopLoad);
+    if (options.spectators > 0) {
+        printf("%lu spectators watching match %u on port %u\n", options.spectators, options.match_id, options.server.port);
+    }
+    if (options.bots > 0) {
+        printf("%lu bots on port %u, %lu more every %.1f s\n", options.bots, options.server.port, options.increment, options.duration);
+    }
+
+    LoadStats total, last;
+    memset(&total, 0, sizeof(total));
+    last = total;
+    BotStats stage;
+    memset(&stage, 0, sizeof(stage));
+    unsigned long started = 0;
+    double stage_start = start;
+    uint32_t newest_tick = 0;
+    double first_arrival = 0.0;
+    double last_report = start;
+    double last_join_scan = start;
+    unsigned long keepalive_next = 0;
+    struct epoll_event events[EPOLL_BATCH];
+    while (!load_stop)
+    {
+        // Report the stage that ended and start the next one's bots
+        double now = GetSeconds();
+        if (options.bots > 0 && (started == 0 || now - stage_start >= options.duration)) {
+            if (started > 0) {
+                PrintStage(bots, started, &stage, now - stage_start);
+                ClearStats(&stage);
+                if (started == options.bots) break;
+            }
+            unsigned long end = options.bots - started > options.increment ? started + options.increment : options.bots;
+            for (; started < end; started++)
+            {
+                SendJoin(&options, &bots[started], now);
+            }
+            stage_start = now;
+        }
+
+        int count = epoll_wait(epoll, events, EPOLL_BATCH, 10);
+        now = GetSeconds();
+        for (int e = 0; e < count; e++)
+        {
+            unsigned long c = (unsigned long)events[e].data.u64;
+            if (c < options.spectators) {
+                ReceiveFrames(&spectators[c], &total, &newest_tick, &first_arrival, c == 0 ? trace : NULL, now);
+            } else {
+                ReceiveStates(&options, &bots[c - options.spectators], &stage, now);
+            }
+        }
+        if (count > 0 && started > 0) {
+            double handled = GetSeconds() - now;
+            AddSample(&stage.loop, handled);
+            stage.busy += handled;
+        }
+
+        // Round robin over the spectators, resending MSG_WATCH where due
+        for (unsigned long checked = 0; checked < options.spectators; checked++)
+        {
+            SpectatorClient* client = &spectators[keepalive_next];
+            if (now - client->last_watch < SPECTATOR_KEEPALIVE) break;
+            SendWatch(&options, client, now);
+            keepalive_next = (keepalive_next + 1) % options.spectators;
+        }
+        // Joins are lost when the server's socket buffer overflows
+        if (now - last_join_scan >= JOIN_RETRY / 4) {
+            for (unsigned long b = 0; b < started; b++)
+            {
+                if (bots[b].phase == BOT_JOINING && now - bots[b].last_join >= JOIN_RETRY) SendJoin(&options, &bots[b], now);
+            }
+            last_join_scan = now;
+        }
+
+        if (options.spectators > 0 && now - last_report >= 1.0) {
+            double interval = now - last_report;
+            unsigned long long frames = total.frames - last.frames;
+            printf("frames/s: %.0f (%.1f per spectator), kB/s: %.1f, full: %llu, missing baseline: %llu, invalid: %llu, max spread: %.2f ms\n",
+                   frames / interval, frames / interval / options.spectators, (total.bytes - last.bytes) / interval / 1000.0,
+                   total.full - last.full, total.missing_baseline - last.missing_baseline, total.invalid - last.invalid, total.max_spread * 1e3);
+            fflush(stdout);
+            total.max_spread = 0.0;
+            last = total;
+            last_report = now;
+        }
+        if (options.bots == 0 && options.duration > 0.0 && now - start >= options.duration) break;
+    }
+
+    double elapsed = GetSeconds() - start;
+    if (options.spectators > 0) {
+        printf("frames: %llu in %.1f s, %.1f per spectator per second\n", total.frames, elapsed,
+               elapsed > 0.0 ? total.frames / elapsed / options.spectators : 0.0);
+    }
+
+    unsigned long matched = 0;
+    for (unsigned long b = 0; b < started; b++)
+    {
+        matched += bots[b].matched;
+    }
+    int failed = options.check && matched < started - started % 2;
+    if (options.bots > 0) printf("matched: %lu of %lu bots%s\n", matched, started, failed ? " (check failed)" : "");
+
+    // Free the server's slots now rather than at its player timeout
+    for (unsigned long b = 0; b < started; b++)
+    {
+        if (bots[b].phase == BOT_PLAYING) {
+            unsigned char packet[PROTOCOL_MAX_MESSAGE];
+            SendPacket(bots[b].socket, &options.server, packet, WriteLeaveMessage(packet, bots[b].match_id, bots[b].paddle));
+        }
+    }
+    for (unsigned long c = 0; c < clients; c++)
+    {
+        CloseUdpSocket(c < options.spectators ? spectators[c].socket : bots[c - options.spectators].socket);
+    }
+    if (trace != NULL) fclose(trace);
+    close(epoll);
+    FreeStats(&stage);
+    free(bots);
+    free(spectators);
+    return failed ? 1 : 0;
+}
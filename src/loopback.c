@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "game.h"
+#include "ai.h"
+#include "net.h"
+#include "rollback.h"
+
+// Two rollback peers in one process, talking over real UDP sockets on
+// localhost with simulated latency, jitter and loss. Time is virtual, so a
+// minute of play runs in well under a second and every run is repeatable.
+// Exits with 1 if the peers disagree on the state once all inputs are known.
+
+typedef struct LoopbackOptions {
+    uint32_t ticks;
+    NetConditions conditions;
+    uint32_t input_delay;
+    uint32_t max_prediction;
+    uint64_t seed;
+} LoopbackOptions;
+
+typedef struct Peer {
+    RollbackSession session;
+    int socket;
+    NetLink link;
+    NetAddress remote;
+    double next_frame;
+    int verified;
+    GameState verified_state; // state at options.ticks, once every earlier input is confirmed
+} Peer;
+
+static void Usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [-t ticks] [-l latency_ms] [-j jitter_ms] [-p loss_percent]\n"
+                    "       [-d input_delay] [-m max_prediction] [-s seed]\n", name);
+}
+
+static int ParseOptions(int argc, char** argv, LoopbackOptions* options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc) {
+            Usage(argv[0]);
+            return 0;
+        }
+        const char* value = argv[++i];
+        if (strcmp(argv[i-1], "-t") == 0) {
+            options->ticks = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-l") == 0) {
+            options->conditions.latency = strtod(value, NULL) / 1000.0;
+        } else if (strcmp(argv[i-1], "-j") == 0) {
+            options->conditions.jitter = strtod(value, NULL) / 1000.0;
+        } else if (strcmp(argv[i-1], "-p") == 0) {
+            options->conditions.loss = strtod(value, NULL) / 100.0;
+        } else if (strcmp(argv[i-1], "-d") == 0) {
+            options->input_delay = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-m") == 0) {
+            options->max_prediction = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-s") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else {
+            Usage(argv[0]);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// One frame of a peer: read the network, read the local player, tick, send
+static void RunPeerFrame(Peer* peer, uint32_t verify_tick, double now)
+{
+    unsigned char packet[NET_MAX_PACKET];
+    int size;
+    while ((size = ReceivePacket(peer->socket, NULL, packet, sizeof(packet))) > 0)
+    {
+        ReadRollbackPacket(&peer->session, packet, (size_t)size);
+    }
+
+    RollbackSession* session = &peer->session;
+    AddLocalInput(session, AiInput(&session->state, session->local_paddle));
+    AdvanceRollback(session);
+
+    // Every input before verify_tick is in and applied: that state is final
+    if (!peer->verified && session->remote_confirmed >= verify_tick && session->tick > verify_tick) {
+        peer->verified = LoadGameState(&session->history, verify_tick, &peer->verified_state);
+    }
+
+    size_t length = WriteRollbackPacket(session, packet, sizeof(packet));
+    if (length > 0) NetLinkSend(&peer->link, &peer->remote, packet, length, now);
+}
+
+static int SameState(const GameState* a, const GameState* b)
+{
+    if (memcmp(&a->ball.position, &b->ball.position, sizeof(MiniVector2)) != 0) return 0;
+    if (memcmp(&a->ball.velocity, &b->ball.velocity, sizeof(MiniVector2)) != 0) return 0;
+    for (int p = 0; p < 2; p++)
+    {
+        if (memcmp(&a->paddles[p].position, &b->paddles[p].position, sizeof(MiniVector2)) != 0) return 0;
+        if (memcmp(&a->paddles[p].velocity, &b->paddles[p].velocity, sizeof(MiniVector2)) != 0) return 0;
+        if (a->paddles[p].score != b->paddles[p].score) return 0;
+    }
+    return a->rng.state == b->rng.state;
+}
+
+int main(int argc, char** argv)
+{
+    LoopbackOptions options = {3600, {0.05, 0.01, 0.05}, 2, 8, 0};
+    if (!ParseOptions(argc, argv, &options)) return 1;
+
+    static Peer peers[2];
+    GameState initial = InitGameState(SeedRng(options.seed));
+    for (int p = 0; p < 2; p++)
+    {
+        peers[p].socket = OpenUdpSocket(0);
+        if (peers[p].socket < 0) {
+            fprintf(stderr, "Failed to open a UDP socket\n");
+            return 1;
+        }
+        InitRollbackSession(&peers[p].session, initial, p, options.input_delay, options.max_prediction);
+        InitNetLink(&peers[p].link, peers[p].socket, options.conditions, options.seed * 2 + p + 1);
+        // Start the peers half a frame apart, as real clients never line up
+        peers[p].next_frame = p * 0.5 / 60.0;
+    }
+    peers[0].remote = GetLoopbackAddress(peers[1].socket);
+    peers[1].remote = GetLoopbackAddress(peers[0].socket);
+
+    const double frame_time = 1.0 / 60.0;
+    const double step = 0.0005;
+    const double time_limit = 10.0 + 10.0 * options.ticks * frame_time;
+    double now = 0.0;
+    while (!(peers[0].verified && peers[1].verified) && now < time_limit)
+    {
+        for (int p = 0; p < 2; p++)
+        {
+            FlushNetLink(&peers[p].link, now);
+        }
+        for (int p = 0; p < 2; p++)
+        {
+            if (now >= peers[p].next_frame) {
+                RunPeerFrame(&peers[p], options.ticks, now);
+                peers[p].next_frame += frame_time;
+            }
+        }
+        now += step;
+    }
+
+    int synced = peers[0].verified && peers[1].verified && SameState(&peers[0].verified_state, &peers[1].verified_state);
+    printf("ticks: %u in %.1f s of virtual time\n", options.ticks, now);
+    printf("latency %.0f ms, jitter %.0f ms, loss %.1f%%, input delay %u, max prediction %u\n",
+           options.conditions.latency * 1000.0, options.conditions.jitter * 1000.0, options.conditions.loss * 100.0,
+           peers[0].session.input_delay, peers[0].session.max_prediction);
+    for (int p = 0; p < 2; p++)
+    {
+        const RollbackStats* stats = &peers[p].session.stats;
+        printf("peer %d: %lu rollbacks, %llu ticks re-simulated, max depth %u, %lu stalls, %lu/%lu packets dropped\n",
+               p, stats->rollbacks, stats->resimulated, stats->max_depth, stats->stalls, peers[p].link.dropped, peers[p].link.sent);
+    }
+    printf("score: %u - %u\n", peers[0].verified_state.paddles[0].score, peers[0].verified_state.paddles[1].score);
+    printf("sync: %s\n", synced ? "ok" : "DESYNC");
+
+    for (int p = 0; p < 2; p++)
+    {
+        FreeNetLink(&peers[p].link);
+        CloseUdpSocket(peers[p].socket);
+    }
+    return synced ? 0 : 1;
+}
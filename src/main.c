@@ -2,12 +2,48 @@
 #include <GLFW/glfw3.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "utils.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "render.h"
-#define MINIMATH_IMPLEMENTATION
-#include "minimath.h"
+#include "game.h"
+#include "fixed.h"
+#include "input.h"
+#include "replay.h"
+#include "history.h"
+#include "net.h"
+#include "rollback.h"
+#include "protocol.h"
+#include "snapshot.h"
+#include "jitter.h"
+#include "clock.h"
+
+// Ticks to jump by during replay playback, set from the key callback
+static int replay_seek = 0;
+
+// Last ticks of the float simulation, written out as a replay if we crash
+static GameHistory history;
+static unsigned char crash_replay[HISTORY_REPLAY_BYTES];
+
+static void crash_handler(int sig)
+{
+    // Async-signal-safe calls only: encode into the static buffer, then open/write
+    size_t size = EncodeGameHistory(&history, crash_replay);
+    int file = size > 0 ? open("crash.rpl", O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+    if (file >= 0) {
+        int ok = write(file, crash_replay, size) == (ssize_t)size;
+        close(file);
+        static const char message[] = "Wrote the last ticks to crash.rpl\n";
+        if (ok) write(STDERR_FILENO, message, sizeof(message) - 1);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
 
 void error_callback(int err, const char* description)
 {
@@ -28,158 +64,83 @@ const char* gl_error_to_string(int err)
     }
 }
 
-typedef struct {
-    MiniVector2 position;
-    float radius;
-
-    MiniVector2 velocity;
-} Ball;
-
-Ball InitBall()
-{
-    Ball ball;
-    ball.position = (MiniVector2){400.f, 300.f};
-    ball.radius = 5.f;
-    float angle;
-    do {
-        int angle_deg = rand() % 360; // angle in degrees
-        angle = deg2rad((float)angle_deg);
-    } while (fabs(cos(angle)) < 0.7f);
-    ball.velocity = (MiniVector2){cos(angle) * 10.f, sin(angle) * 10.f};
-
-    return ball;
-}
-
-typedef struct {
-    MiniVector2 position;
-    MiniVector2 size;
-    MiniVector2 velocity;
-    unsigned int score;
-    char score_string[10];
-} Paddle;
-
-Paddle InitPaddle(float x, float y)
-{
-    Paddle paddle;
-    paddle.position = (MiniVector2){x, y};
-    paddle.size = (MiniVector2){20.f, 100.f};
-    paddle.velocity = (MiniVector2){0.f, 0.f};
-    paddle.score = 0;
-    strncpy(paddle.score_string, "Score: 0", 10);
-    return paddle;
-}
-
-typedef struct {
-    Ball ball;
-    Paddle paddles[2];
-} GameState;
-
-GameState InitGameState()
-{
-    GameState state;
-    state.ball = InitBall();
-    state.paddles[0] = InitPaddle(-10.f, 300.f);
-    state.paddles[1] = InitPaddle(790.f, 300.f);
-
-    return state;
-}
-
-Paddle CheckPaddleCollision(Paddle paddle)
+// Queues every paddle key press and release with its timestamp; the tick loop drains them.
+// Left and right arrows seek a replay by ten seconds.
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
-    Paddle newpaddle = paddle;
-
-    if (paddle.position.y < 0) {
-        newpaddle.position.y = 0;
-    } else if (paddle.position.y + paddle.size.y > 600.f) {
-        newpaddle.position.y = 600.f - paddle.size.y;
+    if (action == GLFW_REPEAT) return;
+
+    if (action == GLFW_PRESS && key == GLFW_KEY_LEFT) replay_seek -= 600;
+    if (action == GLFW_PRESS && key == GLFW_KEY_RIGHT) replay_seek += 600;
+
+    InputEvent event;
+    event.time = glfwGetTime();
+    event.pressed = action == GLFW_PRESS;
+    switch (key) {
+        case GLFW_KEY_E: event.paddle = 0; event.button = INPUT_UP; break;
+        case GLFW_KEY_D: event.paddle = 0; event.button = INPUT_DOWN; break;
+        case GLFW_KEY_UP: event.paddle = 1; event.button = INPUT_UP; break;
+        case GLFW_KEY_DOWN: event.paddle = 1; event.button = INPUT_DOWN; break;
+        default: return;
     }
 
-    return newpaddle;
-}
-
-Ball CheckBallWallCollision(Ball ball)
-{
-    Ball newball = ball;
-
-    if (ball.position.y - ball.radius < 0.f || ball.position.y + ball.radius > 600.f) {
-        newball.velocity.y = -ball.velocity.y;
+    InputQueue* queue = (InputQueue*)glfwGetWindowUserPointer(window);
+    if (!PushInputEvent(queue, event)) {
+        fprintf(stderr, "Input queue full, dropped key event\n");
     }
-
-    return newball;
 }
 
-Ball CheckBallPaddleCollision(Ball ball, Paddle paddle)
+int main(int argc, char** argv)
 {
-    Ball newball = ball;
-
-    if (ball.position.x > paddle.position.x && ball.position.x < paddle.position.x + paddle.size.x && ball.position.y > paddle.position.y && ball.position.y < paddle.position.y + paddle.size.y) {
-
-        float distanceToCenter = ball.position.y - (paddle.position.y + paddle.size.y / 2);
-        float angle = distanceToCenter / 50.f * M_PI / 4.f;
-        if (ball.velocity.x < 0) {
-            newball.velocity.x = cos(angle) * 10.f;
-            newball.velocity.y = sin(angle) * 10.f;
-        } else {
-            newball.velocity.x = -cos(angle) * 10.f;
-            newball.velocity.y = sin(angle) * 10.f;
+    // --fixed runs the deterministic fixed-point simulation
+    // --record <file> saves the match as a replay, --replay <file> plays one back
+    // --net <paddle> <local_port> <host:port> plays one paddle against a remote
+    // peer with rollback; both sides must pass the same --seed
+    // --server <host:port> joins a match on pong-server and renders its snapshots
+    int use_fixed = 0;
+    const char* record_path = NULL;
+    const char* replay_path = NULL;
+    int net_paddle = -1;
+    int net_socket = -1;
+    NetAddress net_remote;
+    int server_socket = -1;
+    NetAddress server_address;
+    int seeded = 0;
+    uint64_t seed = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--fixed") == 0) {
+            use_fixed = 1;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+            seeded = 1;
+        } else if (strcmp(argv[i], "--net") == 0 && i + 3 < argc) {
+            net_paddle = atoi(argv[++i]) != 0;
+            net_socket = OpenUdpSocket((uint16_t)atoi(argv[++i]));
+            if (net_socket < 0 || !ParseNetAddress(argv[++i], &net_remote)) {
+                fprintf(stderr, "Failed to set up the connection\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            server_socket = OpenUdpSocket(0);
+            if (server_socket < 0 || !ParseNetAddress(argv[++i], &server_address)) {
+                fprintf(stderr, "Failed to set up the connection\n");
+                return 1;
+            }
         }
     }
 
-
-    return newball;
-}
-
-void NewSet(GameState* state)
-{
-    state->ball = InitBall();
-    state->paddles[0].position = (MiniVector2){-10.f, 300.f};
-    state->paddles[1].position = (MiniVector2){790.f, 300.f};
-}
-
-void UpdateGame(GameState* state, GLFWwindow* window)
-{
-    state->paddles[0].velocity.y /= 2.f;
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
-        state->paddles[0].velocity.y = 10.f;
-    }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        state->paddles[0].velocity.y = -10.f;
-    }
-
-    state->paddles[1].velocity.y /= 2.f;
-    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
-        state->paddles[1].velocity.y = 10.f;
-    }
-    if(glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
-        state->paddles[1].velocity.y = -10.f;
-    }
-
-    state->ball.position = MiniVector2Add(state->ball.position, state->ball.velocity);
-    state->paddles[0].position = MiniVector2Add(state->paddles[0].position, state->paddles[0].velocity);
-    state->paddles[1].position = MiniVector2Add(state->paddles[1].position, state->paddles[1].velocity);
-
-    // Collision between paddle and walls
-    state->paddles[0] = CheckPaddleCollision(state->paddles[0]);
-    state->paddles[1] = CheckPaddleCollision(state->paddles[1]);
-
-    // Collision between ball and walls
-    state->ball = CheckBallWallCollision(state->ball);
-    state->ball = CheckBallPaddleCollision(state->ball, state->paddles[0]);
-    state->ball = CheckBallPaddleCollision(state->ball, state->paddles[1]);
-
-    if (state->ball.position.x < 0) {
-        state->paddles[1].score++;
-        snprintf(state->paddles[1].score_string, 10, "Score: %u", state->paddles[1].score);
-        NewSet(state);
-    } else if (state->ball.position.x > 800.f) {
-        state->paddles[0].score++;
-        snprintf(state->paddles[0].score_string, 10, "Score: %u", state->paddles[0].score);
-        NewSet(state);
+    Replay replay;
+    ReplayCursor replay_cursor;
+    if (replay_path != NULL) {
+        if (!OpenReplay(&replay, replay_path)) return 1;
+        use_fixed = (replay.flags & REPLAY_FIXED) != 0;
     }
-}
 
-int main()
-{
     glfwSetErrorCallback(error_callback);
     if (!glfwInit()) return 1;
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -191,6 +152,13 @@ int main()
     GLFWwindow* window = glfwCreateWindow(window_width, window_height, "OpenGL pong", NULL, NULL);
     if (window == NULL) return 1;
 
+    static InputQueue input_queue;
+    InitInputQueue(&input_queue);
+    InputState input_state;
+    memset(&input_state, 0, sizeof(input_state));
+    glfwSetWindowUserPointer(window, &input_queue);
+    glfwSetKeyCallback(window, key_callback);
+
     glfwMakeContextCurrent(window);
     gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
 
@@ -198,48 +166,17 @@ int main()
 
     glfwSwapInterval(1); // vsync
 
-    float vertices[4 * 5] = {
-        0.f, 0.f, 0.f, 0.f, 0.f, // bottom left
-        1.f, 0.f, 0.f, 1.f, 0.f, // bottom right
-        1.f, 1.f, 0.f, 1.f, 1.f, // top right
-        0.f, 1.f, 0.f, 0.f, 1.f, // top left
-    };
-
-    unsigned int indexes[6] = {
-        0, 1, 3,
-        3, 1, 2,
-    };
-
-    unsigned int vao, vbo, ebo;
-
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indexes), indexes, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5*sizeof(float), (void*)0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5*sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glBindVertexArray(0);
-
-    unsigned int vertex_shader = LoadShaderFromFile(GL_VERTEX_SHADER, "res/shaders/base.vert");
-    unsigned int rectangle_shader = LoadShaderFromFile(GL_FRAGMENT_SHADER, "res/shaders/rectangle.frag");
-    unsigned int circle_shader = LoadShaderFromFile(GL_FRAGMENT_SHADER, "res/shaders/circle.frag");
-    unsigned int textured_shader = LoadShaderFromFile(GL_FRAGMENT_SHADER, "res/shaders/textured.frag");
-    unsigned int rectangle_program = CreateShaderProgram(vertex_shader, rectangle_shader);
-    unsigned int circle_program = CreateShaderProgram(vertex_shader, circle_shader);
-    unsigned int textured_program = CreateShaderProgram(vertex_shader, textured_shader);
-    glDeleteShader(vertex_shader);
-    glDeleteShader(rectangle_shader);
-    glDeleteShader(circle_shader);
-    glDeleteShader(textured_shader);
+    unsigned int sprite_vertex = LoadShaderFromFile(GL_VERTEX_SHADER, "res/shaders/sprite.vert");
+    unsigned int sprite_fragment = LoadShaderFromFile(GL_FRAGMENT_SHADER, "res/shaders/sprite.frag");
+    unsigned int sprite_program = CreateShaderProgram(sprite_vertex, sprite_fragment);
+    unsigned int text_vertex = LoadShaderFromFile(GL_VERTEX_SHADER, "res/shaders/text.vert");
+    unsigned int text_fragment = LoadShaderFromFile(GL_FRAGMENT_SHADER, "res/shaders/text.frag");
+    unsigned int text_program = CreateShaderProgram(text_vertex, text_fragment);
+    glDeleteShader(sprite_vertex);
+    glDeleteShader(sprite_fragment);
+    glDeleteShader(text_vertex);
+    glDeleteShader(text_fragment);
+    if (!InitSpriteBatch(sprite_program, text_program)) return 1;
 
     stbi_set_flip_vertically_on_load(1);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
@@ -247,11 +184,64 @@ int main()
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     Font m5x7 = LoadFontFromFile("res/fonts/m5x7.ttf", 32);
+    TextMesh score_meshes[2];
+    InitTextMesh(&score_meshes[0]);
+    InitTextMesh(&score_meshes[1]);
 
     glClearColor(0.1f, 0.1f, 0.1f, 1.f);
 
-    srand(time(NULL));
-    GameState state = InitGameState();
+    Rng rng = SeedRng(seeded ? seed : (uint64_t)time(NULL));
+    GameState state = InitGameState(rng);
+    FixedGameState fixed_state = InitFixedGameState(rng);
+    if (use_fixed) {
+        state = FixedToGameState(&fixed_state);
+    }
+
+    ReplayWriter recorder;
+    if (record_path != NULL) {
+        InitReplayWriter(&recorder, rng, REPLAY_DEFAULT_KEYFRAME_INTERVAL, use_fixed);
+    }
+    if (replay_path != NULL) {
+        if (use_fixed) {
+            SeekReplayFixed(&replay, 0, &fixed_state, &replay_cursor);
+            state = FixedToGameState(&fixed_state);
+        } else {
+            SeekReplay(&replay, 0, &state, &replay_cursor);
+        }
+    }
+
+    static RollbackSession session;
+    if (net_socket >= 0) {
+        InitRollbackSession(&session, state, net_paddle, 2, 8);
+    }
+
+    // Server mode: snapshots are kept as delta baselines and played out
+    // through the jitter buffer; match_id stays UINT32_MAX until the
+    // first state arrives, and we keep sending MSG_JOIN until then
+    static SnapshotHistory server_snapshots;
+    static JitterBuffer jitter;
+    StateMessage server_state;
+    server_state.match_id = UINT32_MAX;
+    uint32_t server_ack = 0;
+    int server_finished = 0;
+    // Our ticks follow the server's match clock, a one-way trip ahead, so
+    // inputs go out at the server's tick rate. The server applies the latest
+    // buttons it has whatever their tick, so the lead only stamps them.
+    ClockSync server_clock;
+    double last_ping = 0.0;
+    unsigned long pings = 0, clock_steps = 0;
+    double clock_slewed = 0.0;
+    if (server_socket >= 0) {
+        InitSnapshotHistory(&server_snapshots);
+        InitJitterBuffer(&jitter, 1.0 / 60.0);
+        InitClockSync(&server_clock);
+    }
+
+    InitGameHistory(&history);
+    signal(SIGSEGV, crash_handler);
+    signal(SIGABRT, crash_handler);
+    signal(SIGFPE, crash_handler);
+    uint32_t tick = 0;
 
     const double frame_time = 1.0 / 60.0;
     double last_frame = glfwGetTime();
@@ -266,66 +256,169 @@ int main()
         glfwPollEvents();
 
         double current_time = glfwGetTime();
-        elapsed += current_time - last_frame;
+        double frame_delta = current_time - last_frame;
+        elapsed += frame_delta;
         last_frame = current_time;
 
+        // Drain the server every frame, so pongs are timed on arrival
+        // rather than when the next tick happens to run
+        if (server_socket >= 0) {
+            unsigned char packet[NET_MAX_PACKET];
+            int size;
+            while ((size = ReceivePacket(server_socket, NULL, packet, sizeof(packet))) > 0)
+            {
+                MessageType type;
+                if (!ReadMessageType(packet, (size_t)size, &type)) continue;
+                if (type == MSG_PONG) {
+                    PongMessage pong;
+                    if (!ReadPongMessage(packet, (size_t)size, &pong)) continue;
+                    AddClockSample(&server_clock, pong.client_time * 1e-6, pong.tick * frame_time + pong.since_tick * 1e-6, glfwGetTime());
+                    continue;
+                }
+
+                StateMessage message;
+                uint32_t distance;
+                if (!ReadStateMessage(packet, (size_t)size, &message) || message.paddle > 1) continue;
+                if (!ReadSnapshotBaseline(message.snapshot, message.snapshot_size, &distance)) continue;
+                const Snapshot* baseline = distance > 0 ? FindSnapshot(&server_snapshots, message.tick - distance) : NULL;
+                Snapshot snapshot;
+                if (distance > 0 && baseline == NULL) continue;
+                if (!DecodeSnapshot(message.snapshot, message.snapshot_size, message.tick, baseline, &snapshot)) continue;
+                StoreSnapshot(&server_snapshots, &snapshot);
+                PushJitterSnapshot(&jitter, &snapshot, current_time);
+                if (message.tick > server_ack) server_ack = message.tick;
+                server_state = message;
+                server_finished |= (message.flags & STATE_FINISHED) != 0;
+            }
+        }
+
+        // Slew the accumulator toward the server clock; step it only when far off
+        if (server_socket >= 0 && ClockSynced(&server_clock)) {
+            double target = RemoteTime(&server_clock, current_time) + server_clock.rtt / 2.0;
+            double error = target - (tick * frame_time + elapsed);
+            if (fabs(error) > CLOCK_JUMP) {
+                tick = (uint32_t)(target / frame_time);
+                elapsed = target - tick * frame_time;
+                clock_steps++;
+            } else {
+                double slew = ClockSlew(error, frame_delta);
+                elapsed += slew;
+                clock_slewed += fabs(slew);
+            }
+        }
+
         while (elapsed >= frame_time)
         {
-            UpdateGame(&state, window);
+            // This tick covers [current_time - elapsed, current_time - elapsed + frame_time)
+            double tick_end = current_time - elapsed + frame_time;
+            GameInput input = DrainInputQueue(&input_queue, &input_state, tick_end, current_time);
+            if (server_socket >= 0) {
+                unsigned char packet[NET_MAX_PACKET];
+                int size;
+                if (server_state.match_id == UINT32_MAX) {
+                    size = (int)WriteJoinMessage(packet);
+                } else {
+                    // Either set of keys drives our paddle
+                    InputMessage message = {server_state.match_id, server_state.paddle, input.paddles[0] | input.paddles[1], tick, server_ack};
+                    size = (int)WriteInputMessage(packet, &message);
+                }
+                if (!server_finished) SendPacket(server_socket, &server_address, packet, (size_t)size);
+
+                // Fill the clock filter quickly, then keep it fresh
+                double ping_interval = pings < CLOCK_SAMPLES ? 0.1 : 0.5;
+                if (server_state.match_id != UINT32_MAX && !server_finished && current_time - last_ping >= ping_interval) {
+                    PingMessage ping = {server_state.match_id, server_state.paddle, (uint64_t)(glfwGetTime() * 1e6)};
+                    SendPacket(server_socket, &server_address, packet, WritePingMessage(packet, &ping));
+                    last_ping = current_time;
+                    pings++;
+                }
+                tick++;
+                elapsed -= frame_time;
+                continue;
+            }
+            if (net_socket >= 0) {
+                unsigned char packet[NET_MAX_PACKET];
+                int size;
+                while ((size = ReceivePacket(net_socket, NULL, packet, sizeof(packet))) > 0)
+                {
+                    ReadRollbackPacket(&session, packet, (size_t)size);
+                }
+                // Either set of keys drives our paddle
+                AddLocalInput(&session, input.paddles[0] | input.paddles[1]);
+                AdvanceRollback(&session);
+                size_t length = WriteRollbackPacket(&session, packet, sizeof(packet));
+                if (length > 0) SendPacket(net_socket, &net_remote, packet, length);
+                state = session.state;
+                elapsed -= frame_time;
+                continue;
+            }
+            if (replay_path != NULL) {
+                if (replay_seek != 0) {
+                    long target = (long)replay_cursor.tick + replay_seek;
+                    if (target < 0) target = 0;
+                    if (use_fixed) {
+                        SeekReplayFixed(&replay, (uint32_t)target, &fixed_state, &replay_cursor);
+                        state = FixedToGameState(&fixed_state);
+                    } else {
+                        SeekReplay(&replay, (uint32_t)target, &state, &replay_cursor);
+                    }
+                    replay_seek = 0;
+                    InitGameHistory(&history);
+                }
+                // Hold the last frame once the replay ends
+                if (!NextReplayInput(&replay, &replay_cursor, &input)) {
+                    elapsed -= frame_time;
+                    continue;
+                }
+            }
+            if (record_path != NULL) {
+                if (use_fixed) {
+                    RecordReplayTickFixed(&recorder, &fixed_state, input);
+                } else {
+                    RecordReplayTick(&recorder, &state, input);
+                }
+            }
+            if (!use_fixed) {
+                SaveGameState(&history, tick, &state, input);
+            }
+            tick++;
+            if (use_fixed) {
+                UpdateGameFixed(&fixed_state, input);
+                state = FixedToGameState(&fixed_state);
+            } else {
+                UpdateGame(&state, input);
+            }
             elapsed -= frame_time;
         }
 
+        // Between ticks in server mode: show the match as of the playout time
+        if (server_socket >= 0) {
+            SampleJitterBuffer(&jitter, current_time, &state, NULL);
+        }
+
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glBindVertexArray(vao);
-
-        // draw ball
-        MiniMatrix model = MiniMatrixMultiply(MiniMatrixTranslate(state.ball.position.x - state.ball.radius, state.ball.position.y - state.ball.radius, 0.f), MiniMatrixScale(state.ball.radius * 2.f, state.ball.radius * 2.f, 1.f));
-        MiniMatrix mvp = MiniMatrixMultiply(MiniMatrixMultiply(proj, view), model);
-
-        glUseProgram(circle_program);
-        int mvp_loc = glGetUniformLocation(circle_program, "mvp");
-        int center_loc = glGetUniformLocation(circle_program, "center");
-        int radius_loc = glGetUniformLocation(circle_program, "radius");
-        glUniformMatrix4fv(mvp_loc, 1, GL_FALSE, mvp.data);
-        glUniform2fv(center_loc, 1, (float*)&state.ball.position);
-        glUniform1f(radius_loc, state.ball.radius);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
-
-        // draw paddles
-        glUseProgram(rectangle_program);
-        mvp_loc = glGetUniformLocation(rectangle_program, "mvp");
-        int position_loc = glGetUniformLocation(rectangle_program, "position");
-        int size_loc = glGetUniformLocation(rectangle_program, "size");
-        int time_loc = glGetUniformLocation(rectangle_program, "time");
-        int speed_loc = glGetUniformLocation(rectangle_program, "speed");
-
-        // paddle 1
-        model = MiniMatrixMultiply(MiniMatrixTranslate(state.paddles[0].position.x, state.paddles[0].position.y, 0.f), MiniMatrixScale(state.paddles[0].size.x + 20.f, state.paddles[0].size.y, 1.f));
-        mvp = MiniMatrixMultiply(MiniMatrixMultiply(proj, view), model);
-        glUniformMatrix4fv(mvp_loc, 1, GL_FALSE, mvp.data);
-        glUniform2fv(position_loc, 1, (float*)&state.paddles[0].position);
-        glUniform2fv(size_loc, 1, (float*)&state.paddles[0].size);
-        glUniform1f(time_loc, current_time);
-        glUniform1f(speed_loc, MiniVector2Length(state.paddles[0].velocity));
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
-
-        // paddle 2
-        model = MiniMatrixMultiply(MiniMatrixTranslate(state.paddles[1].position.x - 20.f, state.paddles[1].position.y, 0.f), MiniMatrixScale(state.paddles[1].size.x + 20.f, state.paddles[1].size.y, 1.f));
-        mvp = MiniMatrixMultiply(MiniMatrixMultiply(proj, view), model);
-        glUniformMatrix4fv(mvp_loc, 1, GL_FALSE, mvp.data);
-        glUniform2fv(position_loc, 1, (float*)&state.paddles[1].position);
-        glUniform2fv(size_loc, 1, (float*)&state.paddles[1].size);
-        glUniform1f(time_loc, current_time);
-        glUniform1f(speed_loc, MiniVector2Length(state.paddles[1].velocity));
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
-
-        // score
-        BeginShader(textured_program);
-        DrawText(m5x7, state.paddles[0].score_string, 50.f, 550.f);
-        DrawText(m5x7, state.paddles[1].score_string, 650.f, 550.f);
-
-        glBindVertexArray(0);
+        BeginSpriteBatch(current_time);
+
+        // ball
+        DrawCircle(state.ball.position, state.ball.radius, COLOR_WHITE);
+
+        // paddles, wobbling with their speed
+        for (int i = 0; i < 2; i++)
+        {
+            Paddle paddle = state.paddles[i];
+            MiniRect rect = {paddle.position.x, paddle.position.y, paddle.size.x, paddle.size.y};
+            DrawRectangle(rect, COLOR_WHITE, MiniVector2Length(paddle.velocity));
+        }
+
+        // score, laid out again only when it changes
+        for (int i = 0; i < 2; i++)
+        {
+            SetTextMesh(&score_meshes[i], m5x7, state.paddles[i].score_string);
+            DrawTextMesh(&score_meshes[i], i == 0 ? 50.f : 650.f, 550.f);
+        }
+
+        EndSpriteBatch();
         glfwSwapBuffers(window);
 
         GLenum err;
@@ -334,12 +427,58 @@ int main()
         }
     }
 
+    if (input_state.latency_count > 0) {
+        printf("input latency: avg %.2f ms, max %.2f ms over %lu presses\n",
+               1000.0 * input_state.latency_sum / input_state.latency_count, 1000.0 * input_state.latency_max, input_state.latency_count);
+    }
+
+    if (record_path != NULL) {
+        SaveReplay(&recorder, record_path);
+        FreeReplayWriter(&recorder);
+    }
+    if (replay_path != NULL) {
+        CloseReplay(&replay);
+    }
+    if (net_socket >= 0) {
+        printf("rollback: %lu rollbacks, %llu ticks re-simulated, max depth %u, %lu stalls\n",
+               session.stats.rollbacks, session.stats.resimulated, session.stats.max_depth, session.stats.stalls);
+        CloseUdpSocket(net_socket);
+    }
+    if (server_socket >= 0) {
+        if (server_state.match_id != UINT32_MAX && !server_finished) {
+            unsigned char packet[PROTOCOL_MAX_MESSAGE];
+            size_t size = WriteLeaveMessage(packet, server_state.match_id, server_state.paddle);
+            SendPacket(server_socket, &server_address, packet, size);
+        }
+        const JitterStats* stats = &jitter.stats;
+        printf("jitter buffer: %lu snapshots, %lu late, delay %.1f ms, %lu interpolated, %lu extrapolated, %lu held frames\n",
+               stats->received, stats->late, JitterBufferDelay(&jitter) * 1000.0, stats->interpolated, stats->extrapolated, stats->held);
+        printf("server clock: rtt %.1f ms (jitter %.1f ms, min %.1f ms), offset error %.2f ms (bound %.2f ms), drift %.0f ppm, slewed %.1f ms, %lu steps\n",
+               server_clock.rtt * 1000.0, server_clock.rtt_jitter * 1000.0, server_clock.min_rtt * 1000.0, server_clock.error * 1000.0,
+               server_clock.min_rtt * 500.0, server_clock.drift * 1e6, clock_slewed * 1000.0, clock_steps);
+        CloseUdpSocket(server_socket);
+    }
+
+    const SpriteBatchStats* sprites = GetSpriteBatchStats();
+    if (sprites->frames > 0) {
+        printf("sprite batch: %.2f draw calls (max %u), %.0f vertices, %.0f glyphs, %.3f text layouts per frame over %lu frames\n",
+               (double)sprites->draw_calls / sprites->frames, sprites->max_draw_calls, (double)sprites->vertices / sprites->frames,
+               (double)sprites->glyphs / sprites->frames, (double)sprites->layouts / sprites->frames, sprites->frames);
+    }
+
+    const GlyphCacheStats* glyphs = GetGlyphCacheStats(m5x7);
+    if (glyphs != NULL && glyphs->lookups > 0 && sprites->frames > 0) {
+        printf("glyph cache: %.2f%% hits of %llu lookups, %llu rasterized, %llu evicted, %llu dropped, %llu uploads, "
+               "raster %.3f ms per frame (max %.3f ms)\n", 100.0 * glyphs->hits / glyphs->lookups, glyphs->lookups,
+               glyphs->rasterized, glyphs->evicted, glyphs->dropped, glyphs->uploads,
+               glyphs->raster_seconds * 1000.0 / sprites->frames, glyphs->max_frame_raster * 1000.0);
+    }
+
+    FreeTextMesh(&score_meshes[0]);
+    FreeTextMesh(&score_meshes[1]);
     UnloadFont(m5x7);
-    glDeleteProgram(rectangle_program);
-    glDeleteProgram(circle_program);
-    glDeleteProgram(textured_program);
-    glDeleteBuffers(1, &ebo);
-    glDeleteBuffers(1, &vbo);
-    glDeleteBuffers(1, &vao);
+    FreeSpriteBatch();
+    glDeleteProgram(sprite_program);
+    glDeleteProgram(text_program);
     return 0;
 }
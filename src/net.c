@@ -0,0 +1,222 @@
+#ifdef __linux__
+#define _GNU_SOURCE // sendmmsg
+#endif
+#include "net.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static struct sockaddr_in ToSockAddr(const NetAddress* address)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(address->host);
+    addr.sin_port = htons(address->port);
+    return addr;
+}
+
+static int BindUdpSocket(uint16_t port, int shared)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+
+    int one = 1;
+    if (shared && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    NetAddress any = {INADDR_ANY, port};
+    struct sockaddr_in addr = ToSockAddr(&any);
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int OpenUdpSocket(uint16_t port)
+{
+    return BindUdpSocket(port, 0);
+}
+
+int OpenSharedUdpSocket(uint16_t port)
+{
+    return BindUdpSocket(port, 1);
+}
+
+void CloseUdpSocket(int socket)
+{
+    close(socket);
+}
+
+NetAddress GetLoopbackAddress(int socket)
+{
+    struct sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    NetAddress address = {INADDR_LOOPBACK, 0};
+    if (getsockname(socket, (struct sockaddr*)&addr, &length) == 0) {
+        address.port = ntohs(addr.sin_port);
+    }
+    return address;
+}
+
+int ParseNetAddress(const char* text, NetAddress* address)
+{
+    const char* colon = strrchr(text, ':');
+    if (colon == NULL || colon - text >= 64) return 0;
+
+    char host[64];
+    memcpy(host, text, colon - text);
+    host[colon - text] = '\0';
+
+    struct in_addr in;
+    if (strcmp(host, "localhost") == 0) {
+        address->host = INADDR_LOOPBACK;
+    } else if (inet_pton(AF_INET, host, &in) == 1) {
+        address->host = ntohl(in.s_addr);
+    } else {
+        return 0;
+    }
+
+    char* end;
+    unsigned long port = strtoul(colon + 1, &end, 10);
+    if (*end != '\0' || port == 0 || port > 65535) return 0;
+    address->port = (uint16_t)port;
+    return 1;
+}
+
+int SendPacket(int socket, const NetAddress* to, const void* data, size_t size)
+{
+    struct sockaddr_in addr = ToSockAddr(to);
+    return sendto(socket, data, size, 0, (struct sockaddr*)&addr, sizeof(addr)) == (ssize_t)size;
+}
+
+int ReceivePacket(int socket, NetAddress* from, void* data, size_t capacity)
+{
+    struct sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    ssize_t size = recvfrom(socket, data, capacity, 0, (struct sockaddr*)&addr, &length);
+    if (size < 0) return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+
+    if (from != NULL) {
+        from->host = ntohl(addr.sin_addr.s_addr);
+        from->port = ntohs(addr.sin_port);
+    }
+    return (int)size;
+}
+
+#define SEND_BATCH 64
+
+size_t SendPacketToMany(int socket, const NetAddress* to, size_t count, const void* data, size_t size)
+{
+    size_t sent = 0;
+#ifdef __linux__
+    struct sockaddr_in addresses[SEND_BATCH];
+    struct mmsghdr messages[SEND_BATCH];
+    struct iovec iov = {(void*)data, size};
+    memset(messages, 0, sizeof(messages));
+    while (sent < count)
+    {
+        unsigned int batch = count - sent < SEND_BATCH ? (unsigned int)(count - sent) : SEND_BATCH;
+        for (unsigned int i = 0; i < batch; i++)
+        {
+            addresses[i] = ToSockAddr(&to[sent + i]);
+            messages[i].msg_hdr.msg_name = &addresses[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+            messages[i].msg_hdr.msg_iov = &iov;
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        int result = sendmmsg(socket, messages, batch, 0);
+        if (result <= 0) break;
+        sent += (size_t)result;
+        if ((unsigned int)result < batch) break;
+    }
+#else
+    while (sent < count && SendPacket(socket, &to[sent], data, size))
+    {
+        sent++;
+    }
+#endif
+    return sent;
+}
+
+SharedPacket* CreateSharedPacket(const void* data, size_t size, unsigned int references)
+{
+    SharedPacket* packet = malloc(sizeof(SharedPacket) + size);
+    if (packet == NULL) return NULL;
+    atomic_init(&packet->references, references);
+    packet->size = size;
+    memcpy(packet->data, data, size);
+    return packet;
+}
+
+void ReleaseSharedPacket(SharedPacket* packet)
+{
+    if (atomic_fetch_sub_explicit(&packet->references, 1, memory_order_acq_rel) == 1) free(packet);
+}
+
+void InitNetLink(NetLink* link, int socket, NetConditions conditions, uint64_t seed)
+{
+    link->socket = socket;
+    link->conditions = conditions;
+    link->rng = SeedRng(seed);
+    link->packets = malloc(NET_LINK_QUEUE * sizeof(DelayedPacket));
+    link->count = 0;
+    link->sent = 0;
+    link->dropped = 0;
+}
+
+void FreeNetLink(NetLink* link)
+{
+    free(link->packets);
+    link->packets = NULL;
+    link->count = 0;
+}
+
+static inline double RandomUnit(Rng* rng)
+{
+    return RngNext(rng) * (1.0 / 4294967296.0);
+}
+
+int NetLinkSend(NetLink* link, const NetAddress* to, const void* data, size_t size, double now)
+{
+    if (size > NET_MAX_PACKET) return 0;
+    link->sent++;
+
+    if (RandomUnit(&link->rng) < link->conditions.loss || link->count == NET_LINK_QUEUE) {
+        link->dropped++;
+        return 1;
+    }
+
+    DelayedPacket* packet = &link->packets[link->count++];
+    packet->due = now + link->conditions.latency + link->conditions.jitter * RandomUnit(&link->rng);
+    packet->to = *to;
+    packet->size = size;
+    memcpy(packet->data, data, size);
+    return 1;
+}
+
+void FlushNetLink(NetLink* link, double now)
+{
+    // Compact in place so packets that are still held keep their send order
+    size_t kept = 0;
+    for (size_t i = 0; i < link->count; i++)
+    {
+        DelayedPacket* packet = &link->packets[i];
+        if (packet->due <= now) {
+            SendPacket(link->socket, &packet->to, packet->data, packet->size);
+        } else {
+            if (kept != i) link->packets[kept] = *packet;
+            kept++;
+        }
+    }
+    link->count = kept;
+}
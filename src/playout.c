@@ -0,0 +1,260 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "game.h"
+#include "ai.h"
+#include "rng.h"
+#include "snapshot.h"
+#include "jitter.h"
+
+// Plays a packet trace through a client JitterBuffer on a virtual clock and
+// measures what the player would see: how far behind the server the
+// rendered match runs, and how far the rendered ball and paddles are from
+// where the simulation had them at the tick shown. The trace is generated
+// from latency, jitter and loss settings, or read from a file of
+// "tick arrival_seconds" lines such as pong-loadgen -T records; a trace
+// only supplies the timing, and the snapshots come from a local bot match.
+
+#define SERVER_TICK_TIME (1.0 / 60.0)
+
+typedef struct PlayoutOptions {
+    uint32_t ticks;
+    unsigned int rate;          // snapshots per second the server sends
+    unsigned int fps;           // client render rate
+    double latency;
+    double jitter;
+    double loss;
+    uint64_t seed;
+    const char* read_trace;
+    const char* write_trace;
+} PlayoutOptions;
+
+typedef struct Arrival {
+    uint32_t tick;
+    double time;
+} Arrival;
+
+static void Usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [-t ticks] [-r snapshot_rate] [-f fps] [-l latency_ms] [-j jitter_ms]\n"
+                    "       [-p loss_percent] [-s seed] [-R trace] [-T trace]\n", name);
+}
+
+static int ParseOptions(int argc, char** argv, PlayoutOptions* options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc) {
+            Usage(argv[0]);
+            return 0;
+        }
+        const char* value = argv[++i];
+        if (strcmp(argv[i-1], "-t") == 0) {
+            options->ticks = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-r") == 0) {
+            options->rate = (unsigned int)strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-f") == 0) {
+            options->fps = (unsigned int)strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-l") == 0) {
+            options->latency = strtod(value, NULL) / 1000.0;
+        } else if (strcmp(argv[i-1], "-j") == 0) {
+            options->jitter = strtod(value, NULL) / 1000.0;
+        } else if (strcmp(argv[i-1], "-p") == 0) {
+            options->loss = strtod(value, NULL) / 100.0;
+        } else if (strcmp(argv[i-1], "-s") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-R") == 0) {
+            options->read_trace = value;
+        } else if (strcmp(argv[i-1], "-T") == 0) {
+            options->write_trace = value;
+        } else {
+            Usage(argv[0]);
+            return 0;
+        }
+    }
+    if (options->rate == 0 || options->rate > 60 || options->fps == 0) {
+        Usage(argv[0]);
+        return 0;
+    }
+
+    return 1;
+}
+
+static int CompareArrivals(const void* a, const void* b)
+{
+    double ta = ((const Arrival*)a)->time, tb = ((const Arrival*)b)->time;
+    return ta < tb ? -1 : ta > tb;
+}
+
+static int CompareDoubles(const void* a, const void* b)
+{
+    double da = *(const double*)a, db = *(const double*)b;
+    return da < db ? -1 : da > db;
+}
+
+static size_t ReadTrace(const char* path, Arrival** arrivals)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return 0;
+    size_t count = 0, capacity = 1024;
+    *arrivals = malloc(capacity * sizeof(Arrival));
+    unsigned long tick;
+    double time;
+    while (fscanf(file, "%lu %lf", &tick, &time) == 2)
+    {
+        if (tick == 0) continue;
+        if (count == capacity) {
+            capacity *= 2;
+            *arrivals = realloc(*arrivals, capacity * sizeof(Arrival));
+        }
+        (*arrivals)[count++] = (Arrival){(uint32_t)tick, time};
+    }
+    fclose(file);
+    return count;
+}
+
+// Netem-style: every packet delayed by latency plus uniform jitter, which reorders them
+static size_t GenerateTrace(const PlayoutOptions* options, Arrival** arrivals)
+{
+    Rng rng = SeedRng(options->seed + 1);
+    uint32_t interval = 60 / options->rate;
+    size_t count = 0;
+    *arrivals = malloc((options->ticks / interval + 1) * sizeof(Arrival));
+    for (uint32_t tick = interval; tick <= options->ticks; tick += interval)
+    {
+        if (RngNext(&rng) * (1.0 / 4294967296.0) < options->loss) continue;
+        double delay = options->latency + options->jitter * RngNext(&rng) * (1.0 / 4294967296.0);
+        (*arrivals)[count++] = (Arrival){tick, tick * SERVER_TICK_TIME + delay};
+    }
+    return count;
+}
+
+static float Distance(MiniVector2 a, MiniVector2 b)
+{
+    return sqrtf((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+}
+
+static void PrintDistribution(const char* name, double* values, size_t count, double scale, const char* unit)
+{
+    if (count == 0) return;
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        sum += values[i];
+    }
+    qsort(values, count, sizeof(double), CompareDoubles);
+    printf("%s: mean %.2f %s, p50 %.2f, p99 %.2f, max %.2f\n", name, sum / count * scale, unit,
+           values[count / 2] * scale, values[count * 99 / 100] * scale, values[count - 1] * scale);
+}
+
+int main(int argc, char** argv)
+{
+    PlayoutOptions options = {36000, 60, 144, 0.05, 0.02, 0.02, 0, NULL, NULL};
+    if (!ParseOptions(argc, argv, &options)) return 1;
+
+    Arrival* arrivals = NULL;
+    size_t count = options.read_trace != NULL ? ReadTrace(options.read_trace, &arrivals) : GenerateTrace(&options, &arrivals);
+    if (count == 0) {
+        fprintf(stderr, "Empty trace\n");
+        free(arrivals);
+        return 1;
+    }
+    qsort(arrivals, count, sizeof(Arrival), CompareArrivals);
+    if (options.write_trace != NULL) {
+        FILE* file = fopen(options.write_trace, "w");
+        for (size_t i = 0; file != NULL && i < count; i++)
+        {
+            fprintf(file, "%u %.6f\n", arrivals[i].tick, arrivals[i].time);
+        }
+        if (file != NULL) fclose(file);
+    }
+
+    // The match the trace's snapshots are taken from; the fastest packet
+    // sets the baseline latency the buffer adds to
+    uint32_t last_tick = 0;
+    double min_transit = INFINITY;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (arrivals[i].tick > last_tick) last_tick = arrivals[i].tick;
+        double transit = arrivals[i].time - arrivals[i].tick * SERVER_TICK_TIME;
+        if (transit < min_transit) min_transit = transit;
+    }
+    GameState* truth = malloc((last_tick + 2) * sizeof(GameState));
+    truth[0] = InitGameState(SeedRng(options.seed));
+    for (uint32_t t = 1; t <= last_tick + 1; t++)
+    {
+        truth[t] = truth[t - 1];
+        UpdateGame(&truth[t], (GameInput){{AiInput(&truth[t], 0), AiInput(&truth[t], 1)}});
+    }
+
+    JitterBuffer buffer;
+    InitJitterBuffer(&buffer, SERVER_TICK_TIME);
+    double frame_time = 1.0 / options.fps;
+    double end = arrivals[count - 1].time;
+    size_t frames = (size_t)((end - arrivals[0].time) / frame_time) + 1;
+    double* latency = malloc(frames * sizeof(double));
+    double* ball_error = malloc(frames * sizeof(double));
+    double* paddle_error = malloc(frames * sizeof(double));
+    size_t samples = 0, next = 0;
+    for (double now = arrivals[0].time; now <= end && samples < frames; now += frame_time)
+    {
+        while (next < count && arrivals[next].time <= now)
+        {
+            Snapshot snapshot = QuantizeGameState(&truth[arrivals[next].tick], arrivals[next].tick);
+            PushJitterSnapshot(&buffer, &snapshot, arrivals[next].time);
+            next++;
+        }
+
+        GameState shown;
+        double tick;
+        if (!SampleJitterBuffer(&buffer, now, &shown, &tick) || tick < 0.0 || tick >= last_tick) continue;
+
+        // What the simulation had at that fractional tick
+        uint32_t t = (uint32_t)tick;
+        float f = (float)(tick - t);
+        const GameState* a = &truth[t];
+        const GameState* b = &truth[t + 1];
+        MiniVector2 ball = a->ball.position;
+        if (fabsf(b->ball.position.x - ball.x) < 100.f) {
+            ball.x += (b->ball.position.x - ball.x) * f;
+            ball.y += (b->ball.position.y - ball.y) * f;
+        }
+        float paddle = 0.f;
+        for (int p = 0; p < 2; p++)
+        {
+            float y = a->paddles[p].position.y + (b->paddles[p].position.y - a->paddles[p].position.y) * f;
+            paddle = fmaxf(paddle, fabsf(shown.paddles[p].position.y - y));
+        }
+
+        latency[samples] = now - (tick * SERVER_TICK_TIME + min_transit);
+        ball_error[samples] = Distance(shown.ball.position, ball);
+        paddle_error[samples] = paddle;
+        samples++;
+    }
+
+    const JitterStats* stats = &buffer.stats;
+    unsigned long sampled = stats->interpolated + stats->extrapolated + stats->held;
+    if (options.read_trace != NULL) {
+        printf("trace: %s, %zu packets\n", options.read_trace, count);
+    } else {
+        printf("latency %.0f ms, jitter %.0f ms, loss %.1f%%, %u snapshots/s, %zu packets\n", options.latency * 1000.0,
+               options.jitter * 1000.0, options.loss * 100.0, options.rate, count);
+    }
+    printf("received: %lu, late: %lu, dropped: %lu\n", stats->received, stats->late, stats->dropped);
+    printf("frames: %lu at %u fps, %.1f%% interpolated, %.1f%% extrapolated, %.1f%% held\n", sampled, options.fps,
+           sampled ? 100.0 * stats->interpolated / sampled : 0.0, sampled ? 100.0 * stats->extrapolated / sampled : 0.0,
+           sampled ? 100.0 * stats->held / sampled : 0.0);
+    printf("final delay: %.1f ms (jitter estimate %.1f ms, spacing %.2f ticks)\n", JitterBufferDelay(&buffer) * 1000.0,
+           buffer.jitter * 1000.0, buffer.spacing);
+    PrintDistribution("added latency", latency, samples, 1000.0, "ms");
+    PrintDistribution("ball error", ball_error, samples, 1.0, "units");
+    PrintDistribution("paddle error", paddle_error, samples, 1.0, "units");
+
+    free(paddle_error);
+    free(ball_error);
+    free(latency);
+    free(truth);
+    free(arrivals);
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include "protocol.h"
+#include <string.h>
+#include "bytes.h"
+
+#define INPUT_MESSAGE_SIZE (PROTOCOL_HEADER_SIZE + 14)
+#define STATE_HEADER_SIZE (PROTOCOL_HEADER_SIZE + 10)    // followed by the snapshot
+#define LEAVE_MESSAGE_SIZE (PROTOCOL_HEADER_SIZE + 5)
+#define WATCH_MESSAGE_SIZE (PROTOCOL_HEADER_SIZE + 4)
+#define PING_MESSAGE_SIZE (PROTOCOL_HEADER_SIZE + 13)
+#define PONG_MESSAGE_SIZE (PROTOCOL_HEADER_SIZE + 16)
+
+static size_t WriteHeader(unsigned char* buffer, MessageType type)
+{
+    buffer[0] = 'P';
+    buffer[1] = 'N';
+    buffer[2] = PROTOCOL_VERSION;
+    buffer[3] = (unsigned char)type;
+    return PROTOCOL_HEADER_SIZE;
+}
+
+int ReadMessageType(const unsigned char* data, size_t size, MessageType* type)
+{
+    if (size < PROTOCOL_HEADER_SIZE || data[0] != 'P' || data[1] != 'N' || data[2] != PROTOCOL_VERSION) return 0;
+    *type = (MessageType)data[3];
+    return 1;
+}
+
+static int HasType(const unsigned char* data, size_t size, MessageType expected, size_t expected_size)
+{
+    MessageType type;
+    return size >= expected_size && ReadMessageType(data, size, &type) && type == expected;
+}
+
+size_t WriteJoinMessage(unsigned char* buffer)
+{
+    return WriteHeader(buffer, MSG_JOIN);
+}
+
+size_t WriteInputMessage(unsigned char* buffer, const InputMessage* message)
+{
+    unsigned char* p = buffer + WriteHeader(buffer, MSG_INPUT);
+    PutU32(p, message->match_id);
+    p[4] = message->paddle;
+    p[5] = message->buttons;
+    PutU32(p + 6, message->tick);
+    PutU32(p + 10, message->ack);
+    return INPUT_MESSAGE_SIZE;
+}
+
+int ReadInputMessage(const unsigned char* data, size_t size, InputMessage* message)
+{
+    if (!HasType(data, size, MSG_INPUT, INPUT_MESSAGE_SIZE)) return 0;
+    const unsigned char* p = data + PROTOCOL_HEADER_SIZE;
+    message->match_id = GetU32(p);
+    message->paddle = p[4];
+    message->buttons = p[5];
+    message->tick = GetU32(p + 6);
+    message->ack = GetU32(p + 10);
+    return 1;
+}
+
+size_t WriteStateMessage(unsigned char* buffer, const StateMessage* message)
+{
+    unsigned char* p = buffer + WriteHeader(buffer, MSG_STATE);
+    PutU32(p, message->match_id);
+    p[4] = message->paddle;
+    p[5] = message->flags;
+    PutU32(p + 6, message->tick);
+    memcpy(p + 10, message->snapshot, message->snapshot_size);
+    return STATE_HEADER_SIZE + message->snapshot_size;
+}
+
+// The snapshot is left encoded: decoding it needs the receiver's baseline
+int ReadStateMessage(const unsigned char* data, size_t size, StateMessage* message)
+{
+    if (!HasType(data, size, MSG_STATE, STATE_HEADER_SIZE + 1) || size > STATE_HEADER_SIZE + SNAPSHOT_MAX_BYTES) return 0;
+    const unsigned char* p = data + PROTOCOL_HEADER_SIZE;
+    message->match_id = GetU32(p);
+    message->paddle = p[4];
+    message->flags = p[5];
+    message->tick = GetU32(p + 6);
+    message->snapshot_size = size - STATE_HEADER_SIZE;
+    memcpy(message->snapshot, p + 10, message->snapshot_size);
+    return 1;
+}
+
+size_t WriteLeaveMessage(unsigned char* buffer, uint32_t match_id, unsigned char paddle)
+{
+    unsigned char* p = buffer + WriteHeader(buffer, MSG_LEAVE);
+    PutU32(p, match_id);
+    p[4] = paddle;
+    return LEAVE_MESSAGE_SIZE;
+}
+
+int ReadLeaveMessage(const unsigned char* data, size_t size, uint32_t* match_id, unsigned char* paddle)
+{
+    if (!HasType(data, size, MSG_LEAVE, LEAVE_MESSAGE_SIZE)) return 0;
+    *match_id = GetU32(data + PROTOCOL_HEADER_SIZE);
+    *paddle = data[PROTOCOL_HEADER_SIZE + 4];
+    return 1;
+}
+
+size_t WriteWatchMessage(unsigned char* buffer, uint32_t match_id)
+{
+    PutU32(buffer + WriteHeader(buffer, MSG_WATCH), match_id);
+    return WATCH_MESSAGE_SIZE;
+}
+
+int ReadWatchMessage(const unsigned char* data, size_t size, uint32_t* match_id)
+{
+    if (!HasType(data, size, MSG_WATCH, WATCH_MESSAGE_SIZE)) return 0;
+    *match_id = GetU32(data + PROTOCOL_HEADER_SIZE);
+    return 1;
+}
+
+size_t WritePingMessage(unsigned char* buffer, const PingMessage* message)
+{
+    unsigned char* p = buffer + WriteHeader(buffer, MSG_PING);
+    PutU32(p, message->match_id);
+    p[4] = message->paddle;
+    PutU64(p + 5, message->client_time);
+    return PING_MESSAGE_SIZE;
+}
+
+int ReadPingMessage(const unsigned char* data, size_t size, PingMessage* message)
+{
+    if (!HasType(data, size, MSG_PING, PING_MESSAGE_SIZE)) return 0;
+    const unsigned char* p = data + PROTOCOL_HEADER_SIZE;
+    message->match_id = GetU32(p);
+    message->paddle = p[4];
+    message->client_time = GetU64(p + 5);
+    return 1;
+}
+
+size_t WritePongMessage(unsigned char* buffer, const PongMessage* message)
+{
+    unsigned char* p = buffer + WriteHeader(buffer, MSG_PONG);
+    PutU64(p, message->client_time);
+    PutU32(p + 8, message->tick);
+    PutU32(p + 12, message->since_tick);
+    return PONG_MESSAGE_SIZE;
+}
+
+int ReadPongMessage(const unsigned char* data, size_t size, PongMessage* message)
+{
+    if (!HasType(data, size, MSG_PONG, PONG_MESSAGE_SIZE)) return 0;
+    const unsigned char* p = data + PROTOCOL_HEADER_SIZE;
+    message->client_time = GetU64(p);
+    message->tick = GetU32(p + 8);
+    message->since_tick = GetU32(p + 12);
+    return 1;
+}
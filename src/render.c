@@ -1,11 +1,57 @@
 #define STB_TRUETYPE_IMPLEMENTATION
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
 #include "render.h"
 #include "utils.h"
 #include "glad/glad.h"
 
+typedef struct SpriteVertex {
+    float x, y;
+    float u, v;
+    unsigned char color[4];
+    float rect[4];          // the shape's bounds, for the fragment shader
+    float shape, wobble;
+} SpriteVertex;
+
+typedef struct SpriteBatch {
+    unsigned int vao, vbo, ebo;
+    unsigned int program;
+    unsigned int texture;   // 0 until a textured quad of the frame picks one
+    float time;
+    SpriteVertex* vertices; // 4 per quad
+    size_t quads;
+    SpriteBatchStats stats;
+} SpriteBatch;
+
+typedef struct GlyphInstance {
+    float rect[4];          // on screen, in pixels
+    float source[4];        // in the atlas, normalized
+    unsigned char color[4];
+} GlyphInstance;
+
+typedef struct TextMeshDraw {
+    const TextMesh* mesh;
+    float x, y;
+} TextMeshDraw;
+
+typedef struct TextBatch {
+    unsigned int vao, corners, instances;
+    unsigned int program;
+    unsigned int texture;   // the font atlas of every queued glyph
+    GlyphCache* cache;      // and its cache, to upload before drawing
+    GlyphInstance* glyphs;
+    size_t count;
+    TextMeshDraw meshes[TEXT_MESH_DRAWS];
+    size_t mesh_count;
+} TextBatch;
+
 typedef struct RenderState {
     unsigned int shader;
     MiniMatrix projview;
+    SpriteBatch batch;
+    TextBatch text;
 } RenderState;
 
 static RenderState render_state = (RenderState){0};
@@ -105,91 +151,325 @@ void UnloadTexture(Texture texture)
     glDeleteTextures(1, &texture.id);
 }
 
-Font LoadFontFromMemory(unsigned char* data, int size)
+static double GetSeconds()
 {
-    stbtt_fontinfo font;
-    if (stbtt_InitFont(&font, data, stbtt_GetFontOffsetForIndex(data, 0)) == 0) {
-        fprintf(stderr, "Failed to load font");
-        return (Font){0};
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static size_t HashCodepoint(int codepoint, size_t mask)
+{
+    return ((uint32_t)codepoint * 2654435761u) & mask;
+}
+
+static int FindCell(const GlyphCache* cache, int codepoint)
+{
+    if (codepoint < FONT_INDEX_SIZE) return cache->direct[codepoint];
+    for (size_t h = HashCodepoint(codepoint, cache->table_mask); cache->table[h] >= 0; h = (h + 1) & cache->table_mask)
+    {
+        if (cache->glyphs[cache->table[h]].codepoint == codepoint) return cache->table[h];
     }
-    const char* codepoints = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789!?:";
-    int total_width = 0;
-    int total_height = 0;
-    float scale = stbtt_ScaleForPixelHeight(&font, size);
-    unsigned char** bitmaps = (unsigned char**)malloc(strlen(codepoints) * sizeof(unsigned char*));
-    Glyph* glyphs = (Glyph*)malloc(strlen(codepoints) * sizeof(Glyph));
+    return -1;
+}
 
-    for (int i = 0; i < strlen(codepoints); i++)
+static void InsertCell(GlyphCache* cache, int codepoint, int cell)
+{
+    if (codepoint < FONT_INDEX_SIZE) {
+        cache->direct[codepoint] = (short)cell;
+        return;
+    }
+    size_t h = HashCodepoint(codepoint, cache->table_mask);
+    while (cache->table[h] >= 0)
     {
-        int codepoint = (int)codepoints[i];
-        int width, height, xoffset, yoffset, advance, lsb;
-        if (!stbtt_FindGlyphIndex(&font, codepoint)) {
-            fprintf(stderr, "Codepoint not found in font: U+%04x\n", codepoint);
-            continue;
+        h = (h + 1) & cache->table_mask;
+    }
+    cache->table[h] = cell;
+}
+
+// Backward shift deletion, so lookups never need tombstones
+static void RemoveCell(GlyphCache* cache, int codepoint)
+{
+    if (codepoint < FONT_INDEX_SIZE) {
+        cache->direct[codepoint] = -1;
+        return;
+    }
+    size_t mask = cache->table_mask;
+    size_t hole = HashCodepoint(codepoint, mask);
+    while (cache->glyphs[cache->table[hole]].codepoint != codepoint)
+    {
+        hole = (hole + 1) & mask;
+    }
+    cache->table[hole] = -1;
+    for (size_t next = (hole + 1) & mask; cache->table[next] >= 0; next = (next + 1) & mask)
+    {
+        // An entry may fill the hole unless its home lies between the two
+        size_t home = HashCodepoint(cache->glyphs[cache->table[next]].codepoint, mask);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            cache->table[hole] = cache->table[next];
+            cache->table[next] = -1;
+            hole = next;
         }
+    }
+}
+
+#define KERN_EMPTY 0xffffffffu
 
-        bitmaps[i] = stbtt_GetCodepointBitmap(&font, 0, scale, codepoint, &width, &height, &xoffset, &yoffset);
-        stbtt_GetCodepointHMetrics(&font, codepoint, &advance, &lsb);
-        if (height > total_height) {
-            total_height = height;
+static size_t HashKernPair(unsigned int glyphs, size_t mask)
+{
+    return (glyphs * 2654435761u) & mask;
+}
+
+// Reads the kern table into a hash once, so misses and layout never search
+// the font: the first subtable, horizontal and format 0, like stbtt_GetGlyphKernAdvance
+static int LoadKerning(GlyphCache* cache, float scale)
+{
+    if (!cache->info.kern) return 1;
+    stbtt_uint8* data = cache->info.data + cache->info.kern;
+    if (ttUSHORT(data + 2) < 1 || ttUSHORT(data + 8) != 1) return 1;
+    size_t pairs = ttUSHORT(data + 10);
+    size_t size = 1;
+    while (size < pairs * 2)
+    {
+        size *= 2;
+    }
+    cache->kerning = (KernPair*)malloc(size * sizeof(KernPair));
+    if (cache->kerning == NULL) return 0;
+    cache->kerning_mask = size - 1;
+    for (size_t h = 0; h < size; h++)
+    {
+        cache->kerning[h].glyphs = KERN_EMPTY;
+    }
+    for (size_t p = 0; p < pairs; p++)
+    {
+        int advance = ttSHORT(data + 22 + p * 6);
+        if (advance == 0) continue;
+        unsigned int glyphs = ttULONG(data + 18 + p * 6);
+        size_t h = HashKernPair(glyphs, cache->kerning_mask);
+        while (cache->kerning[h].glyphs != KERN_EMPTY && cache->kerning[h].glyphs != glyphs)
+        {
+            h = (h + 1) & cache->kerning_mask;
         }
-        total_width += width;
+        cache->kerning[h].glyphs = glyphs;
+        cache->kerning[h].advance = advance * scale;
+    }
+    return 1;
+}
 
-        glyphs[i].codepoint = codepoint;
-        if (i == 0) {
-            glyphs[i].texture_rect.x = 0;
-        } else {
-            glyphs[i].texture_rect.x = glyphs[i-1].texture_rect.x + glyphs[i-1].texture_rect.w;
+static float GetKerning(const GlyphCache* cache, int left, int right)
+{
+    if (cache->kerning == NULL) return 0.f;
+    unsigned int glyphs = (unsigned int)left << 16 | (unsigned int)right;
+    for (size_t h = HashKernPair(glyphs, cache->kerning_mask); cache->kerning[h].glyphs != KERN_EMPTY; h = (h + 1) & cache->kerning_mask)
+    {
+        if (cache->kerning[h].glyphs == glyphs) return cache->kerning[h].advance;
+    }
+    return 0.f;
+}
+
+// A free cell, else the least recently used one nothing still needs; misses
+// rasterize a glyph anyway, so a scan of the cells costs little next to it
+static int ChooseCell(const GlyphCache* cache, unsigned long frame)
+{
+    int best = -1;
+    for (size_t c = 0; c < cache->glyphs_num; c++)
+    {
+        if (cache->glyphs[c].codepoint < 0) return (int)c;
+        if (cache->pins[c] > 0 || cache->last_used[c] == frame) continue;
+        if (best < 0 || cache->last_used[c] < cache->last_used[best]) best = (int)c;
+    }
+    return best;
+}
+
+static void MarkDirty(GlyphCache* cache, MiniRecti rect)
+{
+    if (cache->dirty_count < FONT_DIRTY_RECTS) {
+        cache->dirty[cache->dirty_count++] = rect;
+        return;
+    }
+    MiniRecti* last = &cache->dirty[FONT_DIRTY_RECTS - 1];
+    int x1 = last->x + last->w > rect.x + rect.w ? last->x + last->w : rect.x + rect.w;
+    int y1 = last->y + last->h > rect.y + rect.h ? last->y + last->h : rect.y + rect.h;
+    if (rect.x < last->x) last->x = rect.x;
+    if (rect.y < last->y) last->y = rect.y;
+    last->w = x1 - last->x;
+    last->h = y1 - last->y;
+}
+
+static void RasterizeGlyph(Font font, int codepoint, int cell)
+{
+    GlyphCache* cache = font.cache;
+    double start = GetSeconds();
+    int index = stbtt_FindGlyphIndex(&cache->info, codepoint); // 0, the font's missing glyph box, if it has none
+    int x0, y0, x1, y1, advance, lsb;
+    stbtt_GetGlyphBitmapBox(&cache->info, index, font.scale, font.scale, &x0, &y0, &x1, &y1);
+    stbtt_GetGlyphHMetrics(&cache->info, index, &advance, &lsb);
+    int width = x1 - x0 < cache->cell_width - 1 ? x1 - x0 : cache->cell_width - 1;
+    int height = y1 - y0 < cache->cell_height - 1 ? y1 - y0 : cache->cell_height - 1;
+
+    MiniRecti rect = {(cell % cache->columns) * cache->cell_width, (cell / cache->columns) * cache->cell_height, cache->cell_width, cache->cell_height};
+    unsigned char* bottom = cache->pixels + rect.y * FONT_ATLAS_SIZE + rect.x;
+    for (int y = 0; y < rect.h; y++)
+    {
+        memset(bottom + y * FONT_ATLAS_SIZE, 0, rect.w);
+    }
+    // Bitmap rows run top down and the atlas bottom up, so start at the top with a negative stride
+    if (width > 0 && height > 0) {
+        stbtt_MakeGlyphBitmap(&cache->info, bottom + (height - 1) * FONT_ATLAS_SIZE, width, height, -FONT_ATLAS_SIZE, font.scale, font.scale, index);
+    }
+    MarkDirty(cache, rect);
+
+    Glyph* glyph = &cache->glyphs[cell];
+    glyph->codepoint = codepoint;
+    glyph->index = index;
+    glyph->texture_rect = (MiniRecti){rect.x, rect.y, width, height};
+    glyph->texture_coords = (MiniRect){(float)rect.x / FONT_ATLAS_SIZE, (float)rect.y / FONT_ATLAS_SIZE,
+                                       (float)width / FONT_ATLAS_SIZE, (float)height / FONT_ATLAS_SIZE};
+    glyph->xoffset = x0;
+    glyph->yoffset = y0;
+    glyph->advance = advance * font.scale;
+    glyph->lsb = (float)lsb * font.scale;
+
+    double seconds = GetSeconds() - start;
+    cache->stats.rasterized++;
+    cache->stats.raster_seconds += seconds;
+    cache->frame_raster += seconds;
+    if (cache->frame_raster > cache->stats.max_frame_raster) {
+        cache->stats.max_frame_raster = cache->frame_raster;
+    }
+}
+
+// The glyph's cell, rasterizing it if it is not cached; -1 if no cell is free to take it
+static int GetGlyph(Font font, int codepoint)
+{
+    GlyphCache* cache = font.cache;
+    unsigned long frame = render_state.batch.stats.frames;
+    if (cache->frame != frame) {
+        cache->frame = frame;
+        cache->frame_raster = 0.0;
+    }
+
+    if (codepoint < 0) codepoint = 0xfffd;
+    cache->stats.lookups++;
+    int cell = FindCell(cache, codepoint);
+    if (cell >= 0) {
+        cache->stats.hits++;
+    } else {
+        cell = ChooseCell(cache, frame);
+        if (cell < 0) {
+            cache->stats.dropped++;
+            return -1;
+        }
+        if (cache->glyphs[cell].codepoint >= 0) {
+            RemoveCell(cache, cache->glyphs[cell].codepoint);
+            cache->stats.evicted++;
         }
-        glyphs[i].texture_rect.y = 0;
-        glyphs[i].texture_rect.w = width;
-        glyphs[i].texture_rect.h = height;
-        glyphs[i].xoffset = xoffset;
-        glyphs[i].yoffset = yoffset;
-        glyphs[i].advance = advance * scale;
-        glyphs[i].lsb = (float)lsb * scale;
+        RasterizeGlyph(font, codepoint, cell);
+        InsertCell(cache, codepoint, cell);
     }
+    cache->last_used[cell] = frame;
+    return cell;
+}
 
+// Sends the cells rasterized since the last upload to the atlas
+static void UploadGlyphCache(GlyphCache* cache, unsigned int texture)
+{
+    if (cache == NULL || cache->dirty_count == 0) return;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, FONT_ATLAS_SIZE);
+    for (size_t i = 0; i < cache->dirty_count; i++)
+    {
+        MiniRecti rect = cache->dirty[i];
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.w, rect.h, GL_RED, GL_UNSIGNED_BYTE, cache->pixels + rect.y * FONT_ATLAS_SIZE + rect.x);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    cache->stats.uploads += cache->dirty_count;
+    cache->dirty_count = 0;
+}
+
+static void FreeGlyphCache(GlyphCache* cache)
+{
+    if (cache == NULL) return;
+    free(cache->glyphs);
+    free(cache->last_used);
+    free(cache->pins);
+    free(cache->table);
+    free(cache->kerning);
+    free(cache->pixels);
+    free(cache->data);
+    free(cache);
+}
+
+Font LoadFontFromMemory(unsigned char* data, int size)
+{
+    GlyphCache* cache = (GlyphCache*)calloc(1, sizeof(GlyphCache));
+    if (cache == NULL || stbtt_InitFont(&cache->info, data, stbtt_GetFontOffsetForIndex(data, 0)) == 0) {
+        fprintf(stderr, "Failed to load font");
+        free(cache);
+        return (Font){0};
+    }
+    float scale = stbtt_ScaleForPixelHeight(&cache->info, size);
+
+    // Every cell fits the font's largest glyph, plus a pixel so linear
+    // filtering does not bleed in the neighbours
+    int x0, y0, x1, y1;
+    stbtt_GetFontBoundingBox(&cache->info, &x0, &y0, &x1, &y1);
+    cache->cell_width = (int)ceilf((x1 - x0) * scale) + 1;
+    cache->cell_height = (int)ceilf((y1 - y0) * scale) + 1;
+    cache->columns = FONT_ATLAS_SIZE / cache->cell_width;
+    cache->glyphs_num = (size_t)cache->columns * (FONT_ATLAS_SIZE / cache->cell_height);
+    size_t table_size = 1;
+    while (table_size < cache->glyphs_num * 2)
+    {
+        table_size *= 2;
+    }
+    cache->table_mask = table_size - 1;
+    cache->glyphs = (Glyph*)malloc(cache->glyphs_num * sizeof(Glyph));
+    cache->last_used = (unsigned long*)calloc(cache->glyphs_num, sizeof(unsigned long));
+    cache->pins = (unsigned int*)calloc(cache->glyphs_num, sizeof(unsigned int));
+    cache->table = (int*)malloc(table_size * sizeof(int));
+    cache->pixels = (unsigned char*)calloc(FONT_ATLAS_SIZE * FONT_ATLAS_SIZE, 1);
+    if (cache->glyphs_num == 0 || cache->glyphs == NULL || cache->last_used == NULL || cache->pins == NULL ||
+        cache->table == NULL || cache->pixels == NULL || !LoadKerning(cache, scale)) {
+        fprintf(stderr, "Font size %d does not fit the glyph atlas\n", size);
+        FreeGlyphCache(cache);
+        return (Font){0};
+    }
+    for (size_t c = 0; c < cache->glyphs_num; c++)
+    {
+        cache->glyphs[c].codepoint = -1;
+    }
+    for (int c = 0; c < FONT_INDEX_SIZE; c++)
+    {
+        cache->direct[c] = -1;
+    }
+    for (size_t h = 0; h < table_size; h++)
+    {
+        cache->table[h] = -1;
+    }
+
+    // One channel, read as white with the coverage for alpha
     unsigned int texture;
+    int swizzle[4] = {GL_ONE, GL_ONE, GL_ONE, GL_RED};
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    unsigned char* base_data = (unsigned char*)malloc(total_width * total_height);
-    memset(base_data, 0, total_width * total_height);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, total_width, total_height, 0, GL_RED, GL_UNSIGNED_BYTE, base_data);
-    free(base_data);
-
-    for (int i = 0; i < strlen(codepoints); i++)
-    {
-        Glyph glyph = glyphs[i];
-        unsigned char* bitmap = bitmaps[i];
-        unsigned char* flipped = (unsigned char*)malloc(glyph.texture_rect.w * glyph.texture_rect.h * 4);
-        for (int y = 0; y < glyph.texture_rect.h; y++)
-        {
-            for (int x = 0; x < glyph.texture_rect.w; x++)
-            {
-                flipped[4 * (y*glyph.texture_rect.w + x)] = 255;
-                flipped[4 * (y*glyph.texture_rect.w + x) + 1] = 255;
-                flipped[4 * (y*glyph.texture_rect.w + x) + 2] = 255;
-                flipped[4 * (y*glyph.texture_rect.w + x) + 3] = bitmap[(glyph.texture_rect.h-1-y)*glyph.texture_rect.w + x];
-            }
-        }
-        glTexSubImage2D(GL_TEXTURE_2D, 0, glyph.texture_rect.x, glyph.texture_rect.y, glyph.texture_rect.w, glyph.texture_rect.h, GL_RGBA, GL_UNSIGNED_BYTE, flipped);
-
-        stbtt_FreeBitmap(bitmap, NULL);
-        free(flipped);
-    }
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, FONT_ATLAS_SIZE, FONT_ATLAS_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, cache->pixels);
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    free(bitmaps);
-
     Font ret;
-    ret.info = font;
-    ret.texture = (Texture){texture, total_width, total_height};
-    ret.glyphs = glyphs;
-    ret.glyphs_num = strlen(codepoints);
+    ret.texture = (Texture){texture, FONT_ATLAS_SIZE, FONT_ATLAS_SIZE};
     ret.scale = scale;
+    ret.cache = cache;
+
+    // Warm the cache with what the HUD is sure to show
+    const char* codepoints = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789!?:";
+    for (int i = 0; i < strlen(codepoints); i++)
+    {
+        GetGlyph(ret, codepoints[i]);
+    }
 
     return ret;
 }
@@ -202,85 +482,431 @@ Font LoadFontFromFile(const char* path, int size)
         return (Font){0};
     }
     Font font = LoadFontFromMemory(data, size);
-    free(data);
+    if (font.cache == NULL) {
+        free(data);
+        return font;
+    }
+    font.cache->data = data;
     return font;
 }
 
 void UnloadFont(Font font)
 {
     UnloadTexture(font.texture);
-    free(font.glyphs);
+    FreeGlyphCache(font.cache);
 }
 
-void DrawText(Font font, const char* text, float x, float y)
+const GlyphCacheStats* GetGlyphCacheStats(Font font)
 {
-    int* indices = (int*)malloc(strlen(text) * sizeof(int));
-    for (int i = 0; i < strlen(text); i++)
+    return font.cache != NULL ? &font.cache->stats : NULL;
+}
+
+void SetProjViewMatrix(MiniMatrix mat)
+{
+    render_state.projview = mat;
+}
+
+// For the bound VAO, from the bound array buffer
+static void SetGlyphInstanceAttributes()
+{
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GlyphInstance), (void*)offsetof(GlyphInstance, rect));
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(GlyphInstance), (void*)offsetof(GlyphInstance, source));
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GlyphInstance), (void*)offsetof(GlyphInstance, color));
+    for (int i = 1; i < 4; i++)
     {
-        for (size_t j = 0; j < font.glyphs_num; j++)
-        {
-            if ((char)font.glyphs[j].codepoint == text[i]) {
-                indices[i] = j;
-                break;
-            }
-
-            if (j == font.glyphs_num - 1) {
-                fprintf(stderr, "Glyph not pre-rendered: %c\n", text[i]);
-            }
-        }
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+}
+
+static int InitTextBatch(unsigned int program)
+{
+    TextBatch* text = &render_state.text;
+    memset(text, 0, sizeof(*text));
+    text->program = program;
+    text->glyphs = (GlyphInstance*)malloc(TEXT_BATCH_GLYPHS * sizeof(GlyphInstance));
+    if (text->glyphs == NULL) return 0;
+
+    // Every glyph is this unit quad, stretched by its instance's rects
+    float corners[4 * 2] = {
+        0.f, 0.f, // bottom left
+        1.f, 0.f, // bottom right
+        0.f, 1.f, // top left
+        1.f, 1.f, // top right
+    };
+
+    glGenVertexArrays(1, &text->vao);
+    glBindVertexArray(text->vao);
+
+    glGenBuffers(1, &text->corners);
+    glBindBuffer(GL_ARRAY_BUFFER, text->corners);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glGenBuffers(1, &text->instances);
+    glBindBuffer(GL_ARRAY_BUFFER, text->instances);
+    glBufferData(GL_ARRAY_BUFFER, TEXT_BATCH_GLYPHS * sizeof(GlyphInstance), NULL, GL_STREAM_DRAW);
+    SetGlyphInstanceAttributes();
+    glBindVertexArray(0);
+
+    return 1;
+}
+
+int InitSpriteBatch(unsigned int program, unsigned int text_program)
+{
+    if (!InitTextBatch(text_program)) return 0;
+    SpriteBatch* batch = &render_state.batch;
+    memset(batch, 0, sizeof(*batch));
+    batch->program = program;
+    batch->vertices = (SpriteVertex*)malloc(SPRITE_BATCH_QUADS * 4 * sizeof(SpriteVertex));
+    unsigned int* indexes = (unsigned int*)malloc(SPRITE_BATCH_QUADS * 6 * sizeof(unsigned int));
+    if (batch->vertices == NULL || indexes == NULL) {
+        free(batch->vertices);
+        free(indexes);
+        return 0;
+    }
+    // Same winding as the old single quad, for every quad of the batch
+    for (unsigned int q = 0; q < SPRITE_BATCH_QUADS; q++)
+    {
+        unsigned int first = q * 4;
+        unsigned int quad[6] = {first, first + 1, first + 3, first + 3, first + 1, first + 2};
+        memcpy(&indexes[q * 6], quad, sizeof(quad));
+    }
+
+    glGenVertexArrays(1, &batch->vao);
+    glBindVertexArray(batch->vao);
+
+    glGenBuffers(1, &batch->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
+    glBufferData(GL_ARRAY_BUFFER, SPRITE_BATCH_QUADS * 4 * sizeof(SpriteVertex), NULL, GL_STREAM_DRAW);
+
+    glGenBuffers(1, &batch->ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, SPRITE_BATCH_QUADS * 6 * sizeof(unsigned int), indexes, GL_STATIC_DRAW);
+    free(indexes);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, x));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, u));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, color));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, rect));
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, shape));
+    for (int i = 0; i < 5; i++)
+    {
+        glEnableVertexAttribArray(i);
+    }
+    glBindVertexArray(0);
+
+    return 1;
+}
+
+void FreeSpriteBatch()
+{
+    SpriteBatch* batch = &render_state.batch;
+    glDeleteBuffers(1, &batch->ebo);
+    glDeleteBuffers(1, &batch->vbo);
+    glDeleteVertexArrays(1, &batch->vao);
+    free(batch->vertices);
+    batch->vertices = NULL;
+
+    TextBatch* text = &render_state.text;
+    glDeleteBuffers(1, &text->instances);
+    glDeleteBuffers(1, &text->corners);
+    glDeleteVertexArrays(1, &text->vao);
+    free(text->glyphs);
+    text->glyphs = NULL;
+}
+
+static void FlushSpriteBatch()
+{
+    SpriteBatch* batch = &render_state.batch;
+    if (batch->quads == 0) return;
+
+    BeginShader(batch->program);
+    glUniformMatrix4fv(glGetUniformLocation(batch->program, "projview"), 1, GL_FALSE, render_state.projview.data);
+    glUniform1f(glGetUniformLocation(batch->program, "time"), batch->time);
+    glBindTexture(GL_TEXTURE_2D, batch->texture);
+
+    // Orphan the buffer so the driver need not wait on the last draw from it
+    glBindVertexArray(batch->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
+    glBufferData(GL_ARRAY_BUFFER, SPRITE_BATCH_QUADS * 4 * sizeof(SpriteVertex), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, batch->quads * 4 * sizeof(SpriteVertex), batch->vertices);
+    glDrawElements(GL_TRIANGLES, (int)(batch->quads * 6), GL_UNSIGNED_INT, (void*)0);
+    glBindVertexArray(0);
+
+    batch->stats.frame_draw_calls++;
+    batch->stats.frame_vertices += (unsigned int)(batch->quads * 4);
+    batch->quads = 0;
+}
+
+static void FlushTextBatch()
+{
+    TextBatch* text = &render_state.text;
+    if (text->count == 0) return;
+
+    BeginShader(text->program);
+    glUniformMatrix4fv(glGetUniformLocation(text->program, "projview"), 1, GL_FALSE, render_state.projview.data);
+    glUniform2f(glGetUniformLocation(text->program, "offset"), 0.f, 0.f);
+    UploadGlyphCache(text->cache, text->texture);
+    glBindTexture(GL_TEXTURE_2D, text->texture);
+
+    glBindVertexArray(text->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, text->instances);
+    glBufferData(GL_ARRAY_BUFFER, TEXT_BATCH_GLYPHS * sizeof(GlyphInstance), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, text->count * sizeof(GlyphInstance), text->glyphs);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (int)text->count);
+    glBindVertexArray(0);
+
+    SpriteBatchStats* stats = &render_state.batch.stats;
+    stats->frame_draw_calls++;
+    stats->frame_glyphs += (unsigned int)text->count;
+    text->count = 0;
+}
+
+// One draw per mesh, straight from its own buffer
+static void FlushTextMeshes()
+{
+    TextBatch* text = &render_state.text;
+    if (text->mesh_count == 0) return;
+
+    BeginShader(text->program);
+    glUniformMatrix4fv(glGetUniformLocation(text->program, "projview"), 1, GL_FALSE, render_state.projview.data);
+    int offset_loc = glGetUniformLocation(text->program, "offset");
+    SpriteBatchStats* stats = &render_state.batch.stats;
+    for (size_t i = 0; i < text->mesh_count; i++)
+    {
+        const TextMeshDraw* draw = &text->meshes[i];
+        glUniform2f(offset_loc, draw->x, draw->y);
+        UploadGlyphCache(draw->mesh->cache, draw->mesh->texture);
+        glBindTexture(GL_TEXTURE_2D, draw->mesh->texture);
+        glBindVertexArray(draw->mesh->vao);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (int)draw->mesh->count);
+        stats->frame_draw_calls++;
+        stats->frame_glyphs += (unsigned int)draw->mesh->count;
+    }
+    glBindVertexArray(0);
+    text->mesh_count = 0;
+}
+
+void BeginSpriteBatch(float time)
+{
+    SpriteBatch* batch = &render_state.batch;
+    batch->time = time;
+    batch->texture = 0;
+    batch->stats.frame_draw_calls = 0;
+    batch->stats.frame_vertices = 0;
+    batch->stats.frame_glyphs = 0;
+}
+
+void EndSpriteBatch()
+{
+    SpriteBatch* batch = &render_state.batch;
+    FlushSpriteBatch();
+    FlushTextBatch();
+    FlushTextMeshes();
+    batch->stats.frames++;
+    batch->stats.draw_calls += batch->stats.frame_draw_calls;
+    batch->stats.vertices += batch->stats.frame_vertices;
+    batch->stats.glyphs += batch->stats.frame_glyphs;
+    if (batch->stats.frame_draw_calls > batch->stats.max_draw_calls) {
+        batch->stats.max_draw_calls = batch->stats.frame_draw_calls;
+    }
+}
+
+void SetSpriteProgram(unsigned int program)
+{
+    if (program == render_state.batch.program) return;
+    FlushSpriteBatch();
+    render_state.batch.program = program;
+}
+
+// quad is the area drawn, rect the shape's bounds within it
+static void PushSprite(MiniRect quad, MiniRect source, Color color, MiniRect rect, SpriteShape shape, float wobble)
+{
+    SpriteBatch* batch = &render_state.batch;
+    if (batch->quads == SPRITE_BATCH_QUADS) FlushSpriteBatch();
+
+    SpriteVertex* v = &batch->vertices[batch->quads * 4];
+    float corners[4][2] = {{0.f, 0.f}, {1.f, 0.f}, {1.f, 1.f}, {0.f, 1.f}}; // bottom left first, counterclockwise
+    for (int i = 0; i < 4; i++)
+    {
+        v[i].x = quad.x + corners[i][0] * quad.w;
+        v[i].y = quad.y + corners[i][1] * quad.h;
+        v[i].u = source.x + corners[i][0] * source.w;
+        v[i].v = source.y + corners[i][1] * source.h;
+        memcpy(v[i].color, &color, 4);
+        v[i].rect[0] = rect.x;
+        v[i].rect[1] = rect.y;
+        v[i].rect[2] = rect.w;
+        v[i].rect[3] = rect.h;
+        v[i].shape = (float)shape;
+        v[i].wobble = wobble;
     }
+    batch->quads++;
+}
 
-    glBindTexture(GL_TEXTURE_2D, font.texture.id);
-    int mvp_loc = glGetUniformLocation(render_state.shader, "mvp");
+void DrawRectangle(MiniRect rect, Color color, float wobble)
+{
+    float margin = ceilf(fabsf(wobble) * 0.5f);
+    MiniRect quad = {rect.x - margin, rect.y, rect.w + 2.f * margin, rect.h};
+    PushSprite(quad, (MiniRect){0.f, 0.f, 1.f, 1.f}, color, rect, SPRITE_RECTANGLE, wobble);
+}
+
+void DrawCircle(MiniVector2 center, float radius, Color color)
+{
+    MiniRect rect = {center.x - radius, center.y - radius, radius * 2.f, radius * 2.f};
+    PushSprite(rect, (MiniRect){0.f, 0.f, 1.f, 1.f}, color, rect, SPRITE_CIRCLE, 0.f);
+}
+
+void DrawTexture(Texture texture, MiniRect source, MiniRect dest, Color tint)
+{
+    SpriteBatch* batch = &render_state.batch;
+    if (batch->texture != texture.id) {
+        // Untextured quads draw with whichever texture is bound
+        if (batch->texture != 0) FlushSpriteBatch();
+        batch->texture = texture.id;
+    }
+    MiniRect uv = {source.x / texture.width, source.y / texture.height, source.w / texture.width, source.h / texture.height};
+    PushSprite(dest, uv, tint, dest, SPRITE_TEXTURED, 0.f);
+}
+
+// Writes the glyphs of UTF-8 text, up to capacity, with the baseline
+// starting at x, y; cells, if not NULL, gets each glyph's cache cell
+static size_t LayoutText(Font font, const char* text, float x, float y, Color color, GlyphInstance* out, short* cells, size_t capacity)
+{
+    if (font.cache == NULL) return 0;
+    const GlyphCache* cache = font.cache;
     MiniVector2 position = {x, y};
     MiniVector2 offset = {0.f, 0.f};
+    size_t count = 0;
+    int previous = -1;
 
-    for (int i = 0; i < strlen(text); i++)
+    while (*text != '\0' && count < capacity)
     {
         // get glyph
-        Glyph glyph = font.glyphs[indices[i]];
+        int index = GetGlyph(font, DecodeUtf8(&text));
+        if (index < 0) continue;
+        const Glyph* glyph = &cache->glyphs[index];
+        if (previous >= 0) offset.x += GetKerning(cache, previous, glyph->index);
+        previous = glyph->index;
 
         // calculate coords on screen
-        offset.x += glyph.lsb;
+        offset.x += glyph->lsb;
         offset.x = roundf(offset.x);
         MiniVector2 glyph_position = MiniVector2Add(position, offset);
+        GlyphInstance* instance = &out[count];
+        instance->rect[0] = glyph_position.x + (float)glyph->xoffset;
+        instance->rect[1] = glyph_position.y - (float)(glyph->yoffset + glyph->texture_rect.h);
+        instance->rect[2] = glyph->texture_rect.w;
+        instance->rect[3] = glyph->texture_rect.h;
+        memcpy(instance->source, &glyph->texture_coords, sizeof(instance->source));
+        memcpy(instance->color, &color, 4);
+        if (cells != NULL) cells[count] = (short)index;
+        count++;
+
+        offset.x += glyph->advance;
+    }
 
-        // calculate tex coords
-        float newvertices[4 * 5] = {
-            0.f, 0.f, 0.f, (float)glyph.texture_rect.x / (float)font.texture.width, (float)glyph.texture_rect.y / (float)font.texture.height, // bottom left
-            1.f, 0.f, 0.f, (float)(glyph.texture_rect.x + glyph.texture_rect.w) / (float)font.texture.width, (float)glyph.texture_rect.y / (float)font.texture.height, // bottom right
-            1.f, 1.f, 0.f, (float)(glyph.texture_rect.x + glyph.texture_rect.w) / (float)font.texture.width, (float)(glyph.texture_rect.y + glyph.texture_rect.h) / (float)font.texture.height, // top right
-            0.f, 1.f, 0.f, (float)glyph.texture_rect.x / (float)font.texture.width, (float)(glyph.texture_rect.y + glyph.texture_rect.h) / (float)font.texture.height, // top left
-        };
-        glBufferData(GL_ARRAY_BUFFER, sizeof(newvertices), newvertices, GL_DYNAMIC_DRAW);
-        offset.x += glyph.advance;
-        if (i < strlen(text)-1) {
-            offset.x += (float)stbtt_GetCodepointKernAdvance(&font.info, glyph.codepoint, font.glyphs[indices[i+1]].codepoint) * font.scale;
-        }
+    render_state.batch.stats.layouts++;
+    return count;
+}
 
-        // upload uniforms
-        MiniMatrix model = MiniMatrixMultiply(MiniMatrixTranslate(glyph_position.x + (float)glyph.xoffset, glyph_position.y - (float)(glyph.yoffset + glyph.texture_rect.h), 0.f), MiniMatrixScale(glyph.texture_rect.w, glyph.texture_rect.h, 1.f));
-        MiniMatrix mvp = MiniMatrixMultiply(render_state.projview, model);
-        glUniformMatrix4fv(mvp_loc, 1, GL_FALSE, mvp.data);
-        
-        // draw elements
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
-    }
-    free(indices);
-
-    float vertices[4 * 5] = {
-        0.f, 0.f, 0.f, 0.f, 0.f, // bottom left
-        1.f, 0.f, 0.f, 1.f, 0.f, // bottom right
-        1.f, 1.f, 0.f, 1.f, 1.f, // top right
-        0.f, 1.f, 0.f, 0.f, 1.f, // top left
-    };
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+void DrawText(Font font, const char* text, float x, float y)
+{
+    TextBatch* batch = &render_state.text;
+    if (batch->count + strlen(text) > TEXT_BATCH_GLYPHS || (batch->count > 0 && batch->texture != font.texture.id)) FlushTextBatch();
+    batch->texture = font.texture.id;
+    batch->cache = font.cache;
+    batch->count += LayoutText(font, text, x, y, COLOR_WHITE, &batch->glyphs[batch->count], NULL, TEXT_BATCH_GLYPHS - batch->count);
+}
 
-    // TODO: one VAO for text, one VAO for sprites
-    // or instanced rendering
+void InitTextMesh(TextMesh* mesh)
+{
+    memset(mesh, 0, sizeof(*mesh));
 }
 
-void SetProjViewMatrix(MiniMatrix mat)
+static void UnpinTextMesh(TextMesh* mesh)
 {
-    render_state.projview = mat;
+    for (size_t i = 0; i < mesh->count; i++)
+    {
+        mesh->cache->pins[mesh->cells[i]]--;
+    }
+    mesh->count = 0;
+}
+
+int SetTextMesh(TextMesh* mesh, Font font, const char* text)
+{
+    if (mesh->text != NULL && mesh->cache == font.cache && strcmp(mesh->text, text) == 0) return 0;
+
+    size_t length = strlen(text);
+    char* copy = (char*)malloc(length + 1);
+    short* cells = (short*)malloc((length + 1) * sizeof(short));
+    GlyphInstance* glyphs = (GlyphInstance*)malloc((length + 1) * sizeof(GlyphInstance));
+    if (copy == NULL || cells == NULL || glyphs == NULL) {
+        free(copy);
+        free(cells);
+        free(glyphs);
+        return 0;
+    }
+    memcpy(copy, text, length + 1);
+    UnpinTextMesh(mesh);
+    free(mesh->text);
+    free(mesh->cells);
+    mesh->text = copy;
+    mesh->cells = cells;
+    mesh->texture = font.texture.id;
+    mesh->cache = font.cache;
+    mesh->count = LayoutText(font, text, 0.f, 0.f, COLOR_WHITE, glyphs, cells, length);
+    for (size_t i = 0; i < mesh->count; i++)
+    {
+        mesh->cache->pins[cells[i]]++;
+    }
+
+    if (mesh->vao == 0) {
+        glGenVertexArrays(1, &mesh->vao);
+        glBindVertexArray(mesh->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, render_state.text.corners);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glGenBuffers(1, &mesh->instances);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->instances);
+        SetGlyphInstanceAttributes();
+        glBindVertexArray(0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->instances);
+    if (mesh->count > mesh->capacity) {
+        glBufferData(GL_ARRAY_BUFFER, mesh->count * sizeof(GlyphInstance), glyphs, GL_DYNAMIC_DRAW);
+        mesh->capacity = mesh->count;
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, mesh->count * sizeof(GlyphInstance), glyphs);
+    }
+    free(glyphs);
+
+    return 1;
+}
+
+void DrawTextMesh(const TextMesh* mesh, float x, float y)
+{
+    TextBatch* batch = &render_state.text;
+    if (mesh->count == 0) return;
+    if (batch->mesh_count == TEXT_MESH_DRAWS) FlushTextMeshes();
+    batch->meshes[batch->mesh_count++] = (TextMeshDraw){mesh, x, y};
+}
+
+void FreeTextMesh(TextMesh* mesh)
+{
+    if (mesh->vao != 0) {
+        glDeleteBuffers(1, &mesh->instances);
+        glDeleteVertexArrays(1, &mesh->vao);
+    }
+    UnpinTextMesh(mesh);
+    free(mesh->cells);
+    free(mesh->text);
+    memset(mesh, 0, sizeof(*mesh));
+}
+
+const SpriteBatchStats* GetSpriteBatchStats()
+{
+    return &render_state.batch.stats;
 }
@@ -0,0 +1,389 @@
+#include "replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytes.h"
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define REPLAY_MMAP 1
+#endif
+
+#define REPLAY_MAX_RUN ((1u << 28) - 1)
+
+static const char replay_magic[8] = {'P', 'O', 'N', 'G', 'R', 'P', 'L', 0};
+
+// Keyframe layout, in 32-bit words
+enum {
+    KF_TICK, KF_RUN, KF_RUN_OFFSET, KF_RESERVED,
+    KF_BALL_X, KF_BALL_Y, KF_BALL_VX, KF_BALL_VY,
+    KF_PADDLE0_Y, KF_PADDLE0_VY, KF_PADDLE1_Y, KF_PADDLE1_VY,
+    KF_SCORE0, KF_SCORE1, KF_RNG_LO, KF_RNG_HI,
+};
+
+static inline unsigned char PackInput(GameInput input)
+{
+    return (input.paddles[0] & 3) | (input.paddles[1] & 3) << 2;
+}
+
+static inline GameInput UnpackInput(uint32_t run)
+{
+    GameInput input;
+    input.paddles[0] = run & 3;
+    input.paddles[1] = (run >> 2) & 3;
+    return input;
+}
+
+void InitReplayWriter(ReplayWriter* writer, Rng seed, uint32_t keyframe_interval, int fixed)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->flags = fixed ? REPLAY_FIXED : 0;
+    writer->seed = seed.state;
+    writer->keyframe_interval = keyframe_interval > 0 ? keyframe_interval : REPLAY_DEFAULT_KEYFRAME_INTERVAL;
+}
+
+void InitReplayWriterInto(ReplayWriter* writer, Rng seed, uint32_t keyframe_interval, int fixed,
+                          uint32_t* runs, size_t run_capacity, unsigned char* keyframes, size_t keyframe_capacity)
+{
+    InitReplayWriter(writer, seed, keyframe_interval, fixed);
+    writer->runs = runs;
+    writer->run_capacity = run_capacity;
+    writer->keyframes = keyframes;
+    writer->keyframe_capacity = keyframe_capacity;
+}
+
+// Appends the input of the next tick and returns the keyframe slot to fill,
+// or NULL if this tick does not start a keyframe
+static unsigned char* RecordInput(ReplayWriter* writer, GameInput input)
+{
+    uint32_t packed = PackInput(input);
+    uint32_t* last = writer->run_count > 0 ? &writer->runs[writer->run_count - 1] : NULL;
+    if (last != NULL && (*last & 15) == packed && (*last >> 4) < REPLAY_MAX_RUN) {
+        *last += 1 << 4;
+    } else {
+        if (writer->run_count == writer->run_capacity) {
+            writer->run_capacity = writer->run_capacity > 0 ? writer->run_capacity * 2 : 256;
+            writer->runs = realloc(writer->runs, writer->run_capacity * sizeof(uint32_t));
+        }
+        writer->runs[writer->run_count++] = packed | 1 << 4;
+    }
+
+    uint32_t tick = writer->ticks++;
+    if (tick % writer->keyframe_interval != 0) return NULL;
+
+    if (writer->keyframe_count == writer->keyframe_capacity) {
+        writer->keyframe_capacity = writer->keyframe_capacity > 0 ? writer->keyframe_capacity * 2 : 64;
+        writer->keyframes = realloc(writer->keyframes, writer->keyframe_capacity * REPLAY_KEYFRAME_SIZE);
+    }
+    unsigned char* keyframe = writer->keyframes + writer->keyframe_count++ * REPLAY_KEYFRAME_SIZE;
+    memset(keyframe, 0, REPLAY_KEYFRAME_SIZE);
+
+    // This tick's input is the last one of the last run
+    uint32_t run = (uint32_t)writer->run_count - 1;
+    PutU32(keyframe + 4 * KF_TICK, tick);
+    PutU32(keyframe + 4 * KF_RUN, run);
+    PutU32(keyframe + 4 * KF_RUN_OFFSET, (writer->runs[run] >> 4) - 1);
+    return keyframe;
+}
+
+void RecordReplayTick(ReplayWriter* writer, const GameState* state, GameInput input)
+{
+    unsigned char* keyframe = RecordInput(writer, input);
+    if (keyframe == NULL) return;
+
+    PutU32(keyframe + 4 * KF_BALL_X, FloatBits(state->ball.position.x));
+    PutU32(keyframe + 4 * KF_BALL_Y, FloatBits(state->ball.position.y));
+    PutU32(keyframe + 4 * KF_BALL_VX, FloatBits(state->ball.velocity.x));
+    PutU32(keyframe + 4 * KF_BALL_VY, FloatBits(state->ball.velocity.y));
+    for (int p = 0; p < 2; p++)
+    {
+        PutU32(keyframe + 4 * (KF_PADDLE0_Y + 2 * p), FloatBits(state->paddles[p].position.y));
+        PutU32(keyframe + 4 * (KF_PADDLE0_VY + 2 * p), FloatBits(state->paddles[p].velocity.y));
+        PutU32(keyframe + 4 * (KF_SCORE0 + p), state->paddles[p].score);
+    }
+    PutU64(keyframe + 4 * KF_RNG_LO, state->rng.state);
+}
+
+void RecordReplayTickFixed(ReplayWriter* writer, const FixedGameState* state, GameInput input)
+{
+    unsigned char* keyframe = RecordInput(writer, input);
+    if (keyframe == NULL) return;
+
+    PutU32(keyframe + 4 * KF_BALL_X, (uint32_t)state->ball.x);
+    PutU32(keyframe + 4 * KF_BALL_Y, (uint32_t)state->ball.y);
+    PutU32(keyframe + 4 * KF_BALL_VX, (uint32_t)state->ball.vx);
+    PutU32(keyframe + 4 * KF_BALL_VY, (uint32_t)state->ball.vy);
+    for (int p = 0; p < 2; p++)
+    {
+        PutU32(keyframe + 4 * (KF_PADDLE0_Y + 2 * p), (uint32_t)state->paddles[p].y);
+        PutU32(keyframe + 4 * (KF_PADDLE0_VY + 2 * p), (uint32_t)state->paddles[p].vy);
+        PutU32(keyframe + 4 * (KF_SCORE0 + p), state->paddles[p].score);
+    }
+    PutU64(keyframe + 4 * KF_RNG_LO, state->rng.state);
+}
+
+static void WriteReplayHeader(const ReplayWriter* writer, unsigned char* header)
+{
+    uint64_t runs_offset = REPLAY_HEADER_SIZE;
+    uint64_t keyframes_offset = runs_offset + writer->run_count * 4;
+
+    memset(header, 0, REPLAY_HEADER_SIZE);
+    memcpy(header, replay_magic, sizeof(replay_magic));
+    PutU32(header + 8, REPLAY_VERSION);
+    PutU32(header + 12, writer->flags);
+    PutU64(header + 16, writer->seed);
+    PutU32(header + 24, writer->ticks);
+    PutU32(header + 28, writer->keyframe_interval);
+    PutU32(header + 32, (uint32_t)writer->keyframe_count);
+    PutU32(header + 36, (uint32_t)writer->run_count);
+    PutU64(header + 40, runs_offset);
+    PutU64(header + 48, keyframes_offset);
+}
+
+int SaveReplay(const ReplayWriter* writer, const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return 0;
+    }
+
+    unsigned char header[REPLAY_HEADER_SIZE];
+    WriteReplayHeader(writer, header);
+    int ok = fwrite(header, sizeof(header), 1, file) == 1;
+    for (size_t i = 0; ok && i < writer->run_count; i++)
+    {
+        unsigned char run[4];
+        PutU32(run, writer->runs[i]);
+        ok = fwrite(run, sizeof(run), 1, file) == 1;
+    }
+    if (ok && writer->keyframe_count > 0) {
+        ok = fwrite(writer->keyframes, REPLAY_KEYFRAME_SIZE, writer->keyframe_count, file) == writer->keyframe_count;
+    }
+
+    if (fclose(file) != 0) ok = 0;
+    if (!ok) fprintf(stderr, "Failed to write %s\n", path);
+    return ok;
+}
+
+size_t ReplayFileSize(const ReplayWriter* writer)
+{
+    return REPLAY_HEADER_SIZE + writer->run_count * 4 + writer->keyframe_count * REPLAY_KEYFRAME_SIZE;
+}
+
+size_t EncodeReplay(const ReplayWriter* writer, unsigned char* out)
+{
+    WriteReplayHeader(writer, out);
+    unsigned char* runs = out + REPLAY_HEADER_SIZE;
+    for (size_t i = 0; i < writer->run_count; i++)
+    {
+        PutU32(runs + i * 4, writer->runs[i]);
+    }
+    if (writer->keyframe_count > 0) {
+        memcpy(runs + writer->run_count * 4, writer->keyframes, writer->keyframe_count * REPLAY_KEYFRAME_SIZE);
+    }
+    return ReplayFileSize(writer);
+}
+
+void FreeReplayWriter(ReplayWriter* writer)
+{
+    free(writer->runs);
+    free(writer->keyframes);
+    memset(writer, 0, sizeof(*writer));
+}
+
+static int ParseReplay(Replay* replay)
+{
+    const unsigned char* data = replay->data;
+    if (replay->size < REPLAY_HEADER_SIZE || memcmp(data, replay_magic, sizeof(replay_magic)) != 0) return 0;
+    if (GetU32(data + 8) != REPLAY_VERSION) return 0;
+
+    replay->flags = GetU32(data + 12);
+    replay->seed = GetU64(data + 16);
+    replay->ticks = GetU32(data + 24);
+    replay->keyframe_interval = GetU32(data + 28);
+    replay->keyframe_count = GetU32(data + 32);
+    replay->run_count = GetU32(data + 36);
+    uint64_t runs_offset = GetU64(data + 40);
+    uint64_t keyframes_offset = GetU64(data + 48);
+
+    if (replay->keyframe_interval == 0 || replay->keyframe_count == 0) return 0;
+    if (runs_offset > replay->size || (replay->size - runs_offset) / 4 < replay->run_count) return 0;
+    if (keyframes_offset > replay->size || (replay->size - keyframes_offset) / REPLAY_KEYFRAME_SIZE < replay->keyframe_count) return 0;
+    if (((uint64_t)replay->ticks + replay->keyframe_interval - 1) / replay->keyframe_interval != replay->keyframe_count) return 0;
+
+    // Runs must be non-empty and together cover no more than the header's ticks
+    uint64_t run_ticks = 0;
+    for (uint32_t r = 0; r < replay->run_count; r++)
+    {
+        uint32_t length = GetU32(data + runs_offset + 4 * (uint64_t)r) >> 4;
+        run_ticks += length;
+        if (length == 0 || run_ticks > replay->ticks) return 0;
+    }
+
+    replay->runs = data + runs_offset;
+    replay->keyframes = data + keyframes_offset;
+    return 1;
+}
+
+int OpenReplay(Replay* replay, const char* path)
+{
+    memset(replay, 0, sizeof(*replay));
+
+#ifdef REPLAY_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                replay->data = data;
+                replay->size = (size_t)st.st_size;
+                replay->mapped = 1;
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    // No mmap: read the whole file
+    if (replay->data == NULL) {
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) {
+            fprintf(stderr, "Failed to open %s\n", path);
+            return 0;
+        }
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        unsigned char* data = size > 0 ? malloc((size_t)size) : NULL;
+        if (data == NULL || fread(data, (size_t)size, 1, file) != 1) {
+            free(data);
+            fclose(file);
+            fprintf(stderr, "Failed to read %s\n", path);
+            return 0;
+        }
+        fclose(file);
+        replay->data = data;
+        replay->size = (size_t)size;
+    }
+
+    if (!ParseReplay(replay)) {
+        fprintf(stderr, "%s is not a valid replay\n", path);
+        CloseReplay(replay);
+        return 0;
+    }
+    return 1;
+}
+
+void CloseReplay(Replay* replay)
+{
+#ifdef REPLAY_MMAP
+    if (replay->mapped) {
+        munmap((void*)replay->data, replay->size);
+    } else
+#endif
+    {
+        free((void*)replay->data);
+    }
+    memset(replay, 0, sizeof(*replay));
+}
+
+int NextReplayInput(const Replay* replay, ReplayCursor* cursor, GameInput* input)
+{
+    if (cursor->tick >= replay->ticks || cursor->run >= replay->run_count) return 0;
+
+    uint32_t run = GetU32(replay->runs + 4 * cursor->run);
+    *input = UnpackInput(run);
+    cursor->tick++;
+    if (++cursor->run_offset >= run >> 4) {
+        cursor->run++;
+        cursor->run_offset = 0;
+    }
+    return 1;
+}
+
+// Keyframe at or before tick; sets the cursor to its position
+static const unsigned char* FindKeyframe(const Replay* replay, uint32_t tick, ReplayCursor* cursor)
+{
+    uint32_t index = tick / replay->keyframe_interval;
+    if (index >= replay->keyframe_count) index = replay->keyframe_count - 1;
+
+    const unsigned char* keyframe = replay->keyframes + (size_t)index * REPLAY_KEYFRAME_SIZE;
+    cursor->tick = GetU32(keyframe + 4 * KF_TICK);
+    cursor->run = GetU32(keyframe + 4 * KF_RUN);
+    cursor->run_offset = GetU32(keyframe + 4 * KF_RUN_OFFSET);
+    return keyframe;
+}
+
+int SeekReplay(const Replay* replay, uint32_t tick, GameState* state, ReplayCursor* cursor)
+{
+    if (replay->flags & REPLAY_FIXED) {
+        FixedGameState fixed;
+        if (!SeekReplayFixed(replay, tick, &fixed, cursor)) return 0;
+        *state = FixedToGameState(&fixed);
+        return 1;
+    }
+
+    const unsigned char* keyframe = FindKeyframe(replay, tick, cursor);
+    *state = InitGameState((Rng){GetU64(keyframe + 4 * KF_RNG_LO)});
+    state->ball.position.x = BitsFloat(GetU32(keyframe + 4 * KF_BALL_X));
+    state->ball.position.y = BitsFloat(GetU32(keyframe + 4 * KF_BALL_Y));
+    state->ball.velocity.x = BitsFloat(GetU32(keyframe + 4 * KF_BALL_VX));
+    state->ball.velocity.y = BitsFloat(GetU32(keyframe + 4 * KF_BALL_VY));
+    for (int p = 0; p < 2; p++)
+    {
+        Paddle* paddle = &state->paddles[p];
+        paddle->position.y = BitsFloat(GetU32(keyframe + 4 * (KF_PADDLE0_Y + 2 * p)));
+        paddle->velocity.y = BitsFloat(GetU32(keyframe + 4 * (KF_PADDLE0_VY + 2 * p)));
+        paddle->score = GetU32(keyframe + 4 * (KF_SCORE0 + p));
+        snprintf(paddle->score_string, sizeof(paddle->score_string), "Score: %u", paddle->score);
+    }
+    // InitGameState drew a serve from the Rng; restore it after
+    state->rng.state = GetU64(keyframe + 4 * KF_RNG_LO);
+
+    GameInput input;
+    while (cursor->tick < tick && NextReplayInput(replay, cursor, &input))
+    {
+        UpdateGame(state, input);
+    }
+    return 1;
+}
+
+int SeekReplayFixed(const Replay* replay, uint32_t tick, FixedGameState* state, ReplayCursor* cursor)
+{
+    if (!(replay->flags & REPLAY_FIXED)) return 0;
+
+    const unsigned char* keyframe = FindKeyframe(replay, tick, cursor);
+    state->ball.x = (Fixed)GetU32(keyframe + 4 * KF_BALL_X);
+    state->ball.y = (Fixed)GetU32(keyframe + 4 * KF_BALL_Y);
+    state->ball.vx = (Fixed)GetU32(keyframe + 4 * KF_BALL_VX);
+    state->ball.vy = (Fixed)GetU32(keyframe + 4 * KF_BALL_VY);
+    for (int p = 0; p < 2; p++)
+    {
+        state->paddles[p].y = (Fixed)GetU32(keyframe + 4 * (KF_PADDLE0_Y + 2 * p));
+        state->paddles[p].vy = (Fixed)GetU32(keyframe + 4 * (KF_PADDLE0_VY + 2 * p));
+        state->paddles[p].score = GetU32(keyframe + 4 * (KF_SCORE0 + p));
+    }
+    state->rng.state = GetU64(keyframe + 4 * KF_RNG_LO);
+
+    // Whole runs share one input, so the event-driven engine skips through them
+    if (tick > replay->ticks) tick = replay->ticks;
+    while (cursor->tick < tick && cursor->run < replay->run_count)
+    {
+        uint32_t run = GetU32(replay->runs + 4 * cursor->run);
+        uint32_t count = (run >> 4) - cursor->run_offset;
+        if (count > tick - cursor->tick) count = tick - cursor->tick;
+
+        AdvanceGameFixed(state, UnpackInput(run), count);
+        cursor->tick += count;
+        cursor->run_offset += count;
+        if (cursor->run_offset >= run >> 4) {
+            cursor->run++;
+            cursor->run_offset = 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,72 @@
+#include "rng.h"
+
+#define RNG_MULTIPLIER 6364136223846793005ULL
+#define RNG_INCREMENT 1442695040888963407ULL
+
+Rng SeedRng(uint64_t seed)
+{
+    Rng rng = {0};
+    RngNext(&rng);
+    rng.state += seed;
+    RngNext(&rng);
+    return rng;
+}
+
+uint32_t RngNext(Rng* rng)
+{
+    uint64_t old = rng->state;
+    rng->state = old * RNG_MULTIPLIER + RNG_INCREMENT;
+    uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = (uint32_t)(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+uint32_t RngBounded(Rng* rng, uint32_t bound)
+{
+    // Reject the few values that would make the low residues more likely
+    uint32_t threshold = -bound % bound;
+    for (;;)
+    {
+        uint32_t r = RngNext(rng);
+        if (r >= threshold) return r % bound;
+    }
+}
+
+// Composes the LCG step with itself delta times (Brown, "Random Number
+// Generation with Arbitrary Strides")
+RngJump MakeRngJump(uint64_t delta)
+{
+    uint64_t cur_mult = RNG_MULTIPLIER;
+    uint64_t cur_plus = RNG_INCREMENT;
+    RngJump jump = {1, 0};
+    while (delta > 0)
+    {
+        if (delta & 1) {
+            jump.mult *= cur_mult;
+            jump.plus = jump.plus * cur_mult + cur_plus;
+        }
+        cur_plus = (cur_mult + 1) * cur_plus;
+        cur_mult *= cur_mult;
+        delta >>= 1;
+    }
+
+    return jump;
+}
+
+void RngJumpAhead(Rng* rng, RngJump jump)
+{
+    rng->state = rng->state * jump.mult + jump.plus;
+}
+
+void RngAdvance(Rng* rng, uint64_t delta)
+{
+    RngJumpAhead(rng, MakeRngJump(delta));
+}
+
+Rng MatchRng(uint64_t root_seed, uint64_t match)
+{
+    Rng rng = SeedRng(root_seed);
+    // The 2^64 period holds 2^32 slices, so match numbers wrap after that
+    RngAdvance(&rng, match * MATCH_RNG_SPACING);
+    return rng;
+}
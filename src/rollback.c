@@ -0,0 +1,143 @@
+#include "rollback.h"
+#include <string.h>
+#include "bytes.h"
+
+#define ROLLBACK_HEADER_SIZE 12
+#define ROLLBACK_NONE UINT32_MAX
+
+static const unsigned char rollback_magic[2] = {'P', 'R'};
+
+static inline uint32_t Slot(uint32_t tick)
+{
+    return tick & (HISTORY_SIZE - 1);
+}
+
+void InitRollbackSession(RollbackSession* session, GameState initial, int local_paddle, uint32_t input_delay, uint32_t max_prediction)
+{
+    memset(session, 0, sizeof(*session));
+    session->local_paddle = local_paddle;
+    session->input_delay = input_delay < HISTORY_SIZE / 4 ? input_delay : HISTORY_SIZE / 4;
+    session->max_prediction = max_prediction > 0 ? max_prediction : 1;
+    if (session->max_prediction > ROLLBACK_MAX_PREDICTION) session->max_prediction = ROLLBACK_MAX_PREDICTION;
+    session->state = initial;
+    session->rollback_tick = ROLLBACK_NONE;
+    InitGameHistory(&session->history);
+
+    // Nothing is pressed during the input delay
+    session->local_count = session->input_delay;
+}
+
+int AddLocalInput(RollbackSession* session, unsigned char input)
+{
+    if (session->local_count > session->tick + session->input_delay) return 0;
+    // Unacknowledged inputs must stay in the ring until the remote has them
+    if (session->local_count - session->remote_ack >= HISTORY_SIZE) return 0;
+
+    session->local_inputs[Slot(session->local_count++)] = input;
+    return 1;
+}
+
+size_t WriteRollbackPacket(const RollbackSession* session, unsigned char* buffer, size_t capacity)
+{
+    uint32_t first = session->remote_ack;
+    uint32_t count = session->local_count - first;
+    if (count > ROLLBACK_MAX_INPUTS) count = ROLLBACK_MAX_INPUTS;
+    if (capacity < ROLLBACK_HEADER_SIZE + count) return 0;
+
+    buffer[0] = rollback_magic[0];
+    buffer[1] = rollback_magic[1];
+    buffer[2] = (unsigned char)count;
+    buffer[3] = (unsigned char)session->local_paddle;
+    PutU32(buffer + 4, first);
+    PutU32(buffer + 8, session->remote_confirmed);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        buffer[ROLLBACK_HEADER_SIZE + i] = session->local_inputs[Slot(first + i)];
+    }
+    return ROLLBACK_HEADER_SIZE + count;
+}
+
+int ReadRollbackPacket(RollbackSession* session, const unsigned char* data, size_t size)
+{
+    if (size < ROLLBACK_HEADER_SIZE || data[0] != rollback_magic[0] || data[1] != rollback_magic[1]) return 0;
+    uint32_t count = data[2];
+    if (data[3] == session->local_paddle || size < ROLLBACK_HEADER_SIZE + count) return 0;
+
+    uint32_t first = GetU32(data + 4);
+    uint32_t ack = GetU32(data + 8);
+    // Packets can arrive out of order; acks only move forward
+    if (ack > session->remote_ack && ack <= session->local_count) session->remote_ack = ack;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t tick = first + i;
+        // Older ticks are duplicates. Newer ones must not reuse the slot of an
+        // unconfirmed tick, or of a tick a rollback may still re-simulate.
+        if (tick < session->remote_confirmed || tick - session->remote_confirmed >= HISTORY_SIZE) continue;
+        if (tick >= session->tick + HISTORY_SIZE - ROLLBACK_MAX_PREDICTION) continue;
+
+        uint32_t slot = Slot(tick);
+        if (session->remote_ticks[slot] == tick + 1) continue;
+
+        unsigned char input = data[ROLLBACK_HEADER_SIZE + i];
+        session->remote_inputs[slot] = input;
+        session->remote_ticks[slot] = tick + 1;
+        if (tick < session->tick && session->predicted[slot] != input && tick < session->rollback_tick) {
+            session->rollback_tick = tick;
+        }
+    }
+
+    while (session->remote_ticks[Slot(session->remote_confirmed)] == session->remote_confirmed + 1)
+    {
+        session->remote_confirmed++;
+    }
+    return 1;
+}
+
+static void SimulateTick(RollbackSession* session, uint32_t tick)
+{
+    uint32_t slot = Slot(tick);
+    unsigned char remote;
+    if (session->remote_ticks[slot] == tick + 1) {
+        remote = session->remote_inputs[slot];
+    } else if (session->remote_confirmed > 0) {
+        // Players mostly keep holding what they held
+        remote = session->remote_inputs[Slot(session->remote_confirmed - 1)];
+    } else {
+        remote = 0;
+    }
+    session->predicted[slot] = remote;
+
+    GameInput input;
+    input.paddles[session->local_paddle] = session->local_inputs[slot];
+    input.paddles[1 - session->local_paddle] = remote;
+
+    SaveGameState(&session->history, tick, &session->state, input);
+    UpdateGame(&session->state, input);
+}
+
+int AdvanceRollback(RollbackSession* session)
+{
+    if (session->rollback_tick < session->tick) {
+        uint32_t depth = session->tick - session->rollback_tick;
+        session->stats.rollbacks++;
+        session->stats.resimulated += depth;
+        if (depth > session->stats.max_depth) session->stats.max_depth = depth;
+
+        LoadGameState(&session->history, session->rollback_tick, &session->state);
+        for (uint32_t tick = session->rollback_tick; tick < session->tick; tick++)
+        {
+            SimulateTick(session, tick);
+        }
+    }
+    session->rollback_tick = ROLLBACK_NONE;
+
+    if (session->tick >= session->local_count || session->tick >= session->remote_confirmed + session->max_prediction) {
+        session->stats.stalls++;
+        return 0;
+    }
+
+    SimulateTick(session, session->tick);
+    session->tick++;
+    return 1;
+}
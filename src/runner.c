@@ -0,0 +1,296 @@
+#include "runner.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+typedef struct RunnerTask {
+    unsigned long begin, end; // match indices
+} RunnerTask;
+
+typedef struct RunnerDeque {
+    pthread_mutex_t lock;
+    RunnerTask* tasks;
+    size_t top, bottom; // steal at top, push/pop at bottom
+    size_t capacity;
+} RunnerDeque;
+
+typedef struct Runner Runner;
+
+typedef struct RunnerWorker {
+    Runner* runner;
+    unsigned int index;
+    pthread_t thread;
+    RunnerDeque deque;
+    RunnerThreadStats stats;
+    unsigned long wins[2];
+} RunnerWorker;
+
+struct Runner {
+    RunnerOptions options;
+    RunnerWorker* workers;
+    atomic_ulong remaining; // matches not finished yet
+    // Idle workers park on idle_cond until a task is pushed or the run ends;
+    // generation counts both, so a push during a failed search is not missed
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    atomic_ulong generation;
+};
+
+static double GetSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// CPU time of the calling thread, so time preempted does not count as busy
+static double GetThreadSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void SignalWork(Runner* runner)
+{
+    pthread_mutex_lock(&runner->idle_lock);
+    atomic_fetch_add(&runner->generation, 1);
+    pthread_cond_broadcast(&runner->idle_cond);
+    pthread_mutex_unlock(&runner->idle_lock);
+}
+
+// Parks until the generation moves past seen or every match is done
+static void WaitForWork(Runner* runner, unsigned long seen)
+{
+    pthread_mutex_lock(&runner->idle_lock);
+    while (atomic_load(&runner->generation) == seen && atomic_load(&runner->remaining) > 0)
+    {
+        pthread_cond_wait(&runner->idle_cond, &runner->idle_lock);
+    }
+    pthread_mutex_unlock(&runner->idle_lock);
+}
+
+static void PushTask(RunnerDeque* deque, RunnerTask task)
+{
+    pthread_mutex_lock(&deque->lock);
+    if (deque->top == deque->bottom) {
+        deque->top = deque->bottom = 0;
+    } else if (deque->bottom == deque->capacity && deque->top > 0) {
+        memmove(deque->tasks, deque->tasks + deque->top, (deque->bottom - deque->top) * sizeof(RunnerTask));
+        deque->bottom -= deque->top;
+        deque->top = 0;
+    }
+    if (deque->bottom == deque->capacity) {
+        deque->capacity = deque->capacity ? deque->capacity * 2 : 16;
+        deque->tasks = (RunnerTask*)realloc(deque->tasks, deque->capacity * sizeof(RunnerTask));
+    }
+    deque->tasks[deque->bottom++] = task;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+static int PopTask(RunnerDeque* deque, RunnerTask* task)
+{
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        *task = deque->tasks[--deque->bottom];
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static int StealTask(RunnerDeque* deque, RunnerTask* task)
+{
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        *task = deque->tasks[deque->top++];
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static int FindTask(RunnerWorker* worker, RunnerTask* task)
+{
+    if (PopTask(&worker->deque, task)) return 1;
+
+    Runner* runner = worker->runner;
+    unsigned int threads = runner->options.threads;
+    for (unsigned int i = 1; i < threads; i++)
+    {
+        RunnerWorker* victim = &runner->workers[(worker->index + i) % threads];
+        if (StealTask(&victim->deque, task)) {
+            worker->stats.steals++;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void CountWin(RunnerWorker* worker, unsigned int score0, unsigned int score1)
+{
+    if (score0 != score1) {
+        worker->wins[score1 > score0]++;
+    }
+}
+
+// Steps the matches of one chunk until each reaches the stop condition
+static void RunTask(RunnerWorker* worker, RunnerTask task, GameBatch* batch, GameInput* inputs)
+{
+    const RunnerOptions* options = &worker->runner->options;
+
+    // Match m always gets the same generator, whichever worker runs it
+    Rng rng = MatchRng(options->seed, task.begin);
+    RngJump next_match = MakeRngJump(MATCH_RNG_SPACING);
+    batch->count = 0;
+    for (unsigned long m = task.begin; m < task.end; m++)
+    {
+        GameBatchAdd(batch, InitGameState(rng));
+        RngJumpAhead(&rng, next_match);
+    }
+
+    for (unsigned long tick = 0; tick < options->max_ticks && batch->count > 0; tick++)
+    {
+        options->policy(batch, inputs, options->policy_user);
+        StepGameBatch(batch, inputs);
+        worker->stats.ticks += batch->count;
+
+        for (size_t i = batch->count; i-- > 0;)
+        {
+            if (batch->score[0][i] >= options->points || batch->score[1][i] >= options->points) {
+                CountWin(worker, batch->score[0][i], batch->score[1][i]);
+                GameBatchRemove(batch, i);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < batch->count; i++)
+    {
+        CountWin(worker, batch->score[0][i], batch->score[1][i]);
+    }
+    worker->stats.tasks++;
+}
+
+static void* WorkerMain(void* arg)
+{
+    RunnerWorker* worker = (RunnerWorker*)arg;
+    Runner* runner = worker->runner;
+    size_t chunk = runner->options.chunk_size;
+
+    GameBatch batch = CreateGameBatch(chunk);
+    GameInput* inputs = (GameInput*)malloc(chunk * sizeof(GameInput));
+    if (batch.memory == NULL || inputs == NULL) {
+        fprintf(stderr, "Runner worker %u failed to allocate its batch\n", worker->index);
+        exit(1);
+    }
+
+    while (atomic_load(&runner->remaining) > 0)
+    {
+        RunnerTask task;
+        unsigned long seen = atomic_load(&runner->generation);
+        if (!FindTask(worker, &task)) {
+            WaitForWork(runner, seen);
+            continue;
+        }
+
+        // Keep halving the range; the upper halves stay stealable
+        int pushed = 0;
+        while (task.end - task.begin > chunk)
+        {
+            unsigned long mid = task.begin + (task.end - task.begin) / 2;
+            PushTask(&worker->deque, (RunnerTask){mid, task.end});
+            task.end = mid;
+            pushed = 1;
+        }
+        if (pushed) SignalWork(runner);
+
+        double start = GetThreadSeconds();
+        RunTask(worker, task, &batch, inputs);
+        worker->stats.busy_seconds += GetThreadSeconds() - start;
+        unsigned long matches = task.end - task.begin;
+        if (atomic_fetch_sub(&runner->remaining, matches) == matches) SignalWork(runner);
+    }
+
+    free(inputs);
+    DestroyGameBatch(&batch);
+    return NULL;
+}
+
+RunnerResult RunMatches(RunnerOptions options)
+{
+    RunnerResult result;
+    memset(&result, 0, sizeof(result));
+
+    if (options.threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        options.threads = cores > 0 ? (unsigned int)cores : 1;
+    }
+    if (options.chunk_size == 0) options.chunk_size = 256;
+
+    // Pick the kernel before the workers race to do it lazily
+    GetBatchKernel();
+
+    Runner runner;
+    runner.options = options;
+    runner.workers = (RunnerWorker*)calloc(options.threads, sizeof(RunnerWorker));
+    atomic_init(&runner.remaining, options.matches);
+    atomic_init(&runner.generation, 0);
+    pthread_mutex_init(&runner.idle_lock, NULL);
+    pthread_cond_init(&runner.idle_cond, NULL);
+
+    // Each worker starts with an equal share of the matches
+    for (unsigned int t = 0; t < options.threads; t++)
+    {
+        RunnerWorker* worker = &runner.workers[t];
+        worker->runner = &runner;
+        worker->index = t;
+        pthread_mutex_init(&worker->deque.lock, NULL);
+        unsigned long begin = options.matches * t / options.threads;
+        unsigned long end = options.matches * (t + 1) / options.threads;
+        if (end > begin) {
+            PushTask(&worker->deque, (RunnerTask){begin, end});
+        }
+    }
+
+    double start = GetSeconds();
+    for (unsigned int t = 0; t < options.threads; t++)
+    {
+        pthread_create(&runner.workers[t].thread, NULL, WorkerMain, &runner.workers[t]);
+    }
+    for (unsigned int t = 0; t < options.threads; t++)
+    {
+        pthread_join(runner.workers[t].thread, NULL);
+    }
+    result.seconds = GetSeconds() - start;
+
+    result.threads = options.threads;
+    result.thread_stats = (RunnerThreadStats*)malloc(options.threads * sizeof(RunnerThreadStats));
+    for (unsigned int t = 0; t < options.threads; t++)
+    {
+        RunnerWorker* worker = &runner.workers[t];
+        result.thread_stats[t] = worker->stats;
+        result.ticks += worker->stats.ticks;
+        result.wins[0] += worker->wins[0];
+        result.wins[1] += worker->wins[1];
+        pthread_mutex_destroy(&worker->deque.lock);
+        free(worker->deque.tasks);
+    }
+    free(runner.workers);
+    pthread_cond_destroy(&runner.idle_cond);
+    pthread_mutex_destroy(&runner.idle_lock);
+
+    return result;
+}
+
+void FreeRunnerResult(RunnerResult* result)
+{
+    free(result->thread_stats);
+    result->thread_stats = NULL;
+}
@@ -0,0 +1,1102 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include "game.h"
+#include "batch.h"
+#include "ai.h"
+#include "net.h"
+#include "protocol.h"
+#include "snapshot.h"
+#include "timer.h"
+
+// Authoritative match server. Each worker thread owns a SO_REUSEPORT socket
+// and an epoll loop over it and a 0.5 ms timerfd, so the kernel sends every
+// client to the same worker each time and workers share little. Within a
+// worker, matches are spread over TICK_GROUPS tick phases about 1 ms apart;
+// a hierarchical timer wheel fires each group's 60 Hz tick, stepping its
+// matches together as one GameBatch, and also runs the player timeouts.
+// Clients are paired into matches in join order through one lobby shared by
+// the workers, since the two players of a match may reach different
+// sockets; the match runs on the first player's worker, and the others
+// forward the match's packets to it. -b adds bot matches that run without
+// any network traffic. States go out as snapshots delta-encoded
+// against the newest one each player has acknowledged.
+//
+// Spectators are kept by the worker their packets reach, which is often not
+// the one running the match. The match's worker encodes each spectator
+// frame once, at a lower rate than player states, and hands the same
+// SharedPacket to every worker with spectators of the match; each sends it
+// to its own spectators with sendmmsg. Spectator frames are deltas against
+// the previous frame, with a full snapshot every second for late joiners and
+// lost packets.
+
+#define SERVER_TICK_RATE 60
+#define PLAYER_TIMEOUT 5.0      // seconds without a packet before a player is dropped
+#define MAX_CATCH_UP 4          // frames a late tick group may run back to back
+#define MATCH_ID_SHIFT 20       // match id = worker << MATCH_ID_SHIFT | slot
+#define NO_MATCH UINT32_MAX
+
+#define TICK_GROUPS 16
+#define WHEEL_UNITS_PER_SECOND 10000    // 100 us timer wheel resolution
+#define WAKEUP_INTERVAL_NS 500000
+#define LATE_TICK 1e-3                  // lateness counted as a late tick
+#define MAX_WORKERS 64                  // workers subscribing to a match are a 64-bit mask
+
+typedef struct ServerOptions {
+    uint16_t port;
+    unsigned int workers;       // 0 uses every online core
+    unsigned long max_matches;
+    unsigned long bots;         // matches played by two AiPolicy bots
+    unsigned int points;        // a match ends when one side reaches this score
+    double duration;            // seconds to run, 0 runs until SIGINT
+    uint64_t seed;
+    unsigned int spectator_rate;    // frames per second sent to spectators
+    unsigned long max_spectators;   // per worker
+} ServerOptions;
+
+typedef struct ServerPlayer {
+    NetAddress address;
+    double last_seen;
+    unsigned char buttons;
+    uint32_t ack;           // newest state tick the player received, 0 for none
+} ServerPlayer;
+
+typedef struct MatchInfo {
+    uint32_t id;
+    uint32_t tick;
+    int bot;
+    ServerPlayer players[2];
+} MatchInfo;
+
+// Matches ticking on the same phase, stepped together
+typedef struct TickGroup {
+    GameBatch batch;
+    MatchInfo* matches;     // parallel to the batch
+    GameInput* inputs;      // parallel to the batch
+    unsigned long bot_count;
+    uint64_t start;         // wheel time of tick 0
+    uint64_t ticks;         // ticks fired or skipped so far
+    double stepped_due;     // GetSeconds() time the last stepped tick was due
+} TickGroup;
+
+// This worker's spectators of one match, sorted by address; the worker
+// keeps its lists sorted by match id
+typedef struct WatchList {
+    uint32_t match_id;
+    NetAddress* addresses;
+    double* last_seen;
+    size_t count;
+    size_t capacity;
+} WatchList;
+
+// Players waiting for an opponent, shared by every worker
+typedef struct Lobby {
+    pthread_mutex_t lock;
+    int has_waiting;
+    ServerPlayer waiting;
+    unsigned int worker;        // received the waiting player's JOIN; runs the match
+} Lobby;
+
+// Sent to the worker running a match: a client packet that reached another
+// worker's socket, or with size 0, a pair from the lobby to start it for
+typedef struct WorkerMail {
+    NetAddress from;
+    ServerPlayer players[2];
+    size_t size;
+    unsigned char data[PROTOCOL_MAX_MESSAGE];
+} WorkerMail;
+
+// A spectator frame on its way from the match's worker to a watching one
+typedef struct SpectatorFrame {
+    uint32_t match_id;
+    int finished;
+    SharedPacket* packet;
+} SpectatorFrame;
+
+typedef struct WorkerStats {
+    atomic_ullong ticks;        // group ticks, each stepping every match of a group
+    atomic_ullong match_ticks;
+    atomic_ullong busy_ns;      // every wakeup, idle ones included
+    atomic_ullong tick_ns;      // stepping tick groups and sending their states
+    atomic_ulong late;          // group ticks that fired more than LATE_TICK late
+    atomic_ulong skipped;       // group ticks dropped after falling too far behind
+    atomic_ulong packets_in;
+    atomic_ulong packets_out;
+    atomic_ulong matches;
+    atomic_ulong bots;
+    atomic_ulong players;
+    atomic_ulong spectators;
+    atomic_ulong spectator_frames;  // encoded by this worker's matches
+    atomic_ulong spectator_packets; // sent to this worker's spectators
+} WorkerStats;
+
+typedef struct Worker {
+    unsigned int index;
+    const ServerOptions* options;
+    struct Worker* peers;       // every worker, by index
+    unsigned int peer_count;
+    pthread_t thread;
+    int socket;
+    int timer;
+    int epoll;
+
+    TickGroup groups[TICK_GROUPS];
+    size_t capacity;
+    uint32_t* match_index;      // slot -> index in its group's batch, NO_MATCH when free
+    unsigned char* match_group; // slot -> tick group
+    SnapshotHistory* snapshots; // slot -> states sent, the delta baselines
+    uint32_t* free_slots;
+    size_t free_count;
+    unsigned long match_count;
+    unsigned long bot_count;
+    Lobby* lobby;
+    Rng rng;                    // seeds new matches
+
+    // Slot -> bit w set while worker w has spectators of the match
+    atomic_ullong* subscribers;
+    Snapshot* spectator_frames; // slot -> last frame sent to spectators, tick 0 for none
+    uint32_t spectator_interval;    // ticks between spectator frames
+
+    WatchList* watches;
+    size_t watch_count;
+    size_t watch_capacity;
+    unsigned long spectator_count;
+    pthread_mutex_t inbox_lock;
+    SpectatorFrame* inbox;      // pushed by the workers running watched matches
+    size_t inbox_count;
+    size_t inbox_capacity;
+    SpectatorFrame* delivering; // the inbox's spare array, swapped in to drain it
+    size_t delivering_capacity;
+    pthread_mutex_t mail_lock;
+    WorkerMail* mail;           // pushed by the other workers
+    size_t mail_count;
+    size_t mail_capacity;
+    WorkerMail* reading;        // the mailbox's spare array
+    size_t reading_capacity;
+
+    // Timers 0..capacity-1 are match timeouts by slot, then one per tick
+    // group, then the spectator sweep
+    TimerWheel wheel;
+    double epoch;               // GetSeconds() at wheel time 0
+    double now;                 // GetSeconds() of the current wakeup
+    LatenessHistogram lateness; // read by the main thread after join
+
+    WorkerStats stats;
+} Worker;
+
+static atomic_int server_stop;
+
+static void StopServer(int sig)
+{
+    atomic_store(&server_stop, 1);
+}
+
+static double GetSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int SameAddress(const NetAddress* a, const NetAddress* b)
+{
+    return a->host == b->host && a->port == b->port;
+}
+
+static size_t MatchSlotBytes()
+{
+    // Batch arrays (10 floats and the Rng), metadata, input, slot tables,
+    // timer, snapshot history, spectator mask and last spectator frame
+    return 10 * sizeof(float) + sizeof(uint64_t) + sizeof(MatchInfo) + sizeof(GameInput) + 2 * sizeof(uint32_t) + 1 + sizeof(TimerEntry) + sizeof(SnapshotHistory) +
+           sizeof(atomic_ullong) + sizeof(Snapshot);
+}
+
+static inline uint64_t WheelTime(const Worker* worker, double seconds)
+{
+    return (uint64_t)((seconds - worker->epoch) * WHEEL_UNITS_PER_SECOND);
+}
+
+static inline uint64_t GroupDue(const TickGroup* group, uint64_t tick)
+{
+    return group->start + tick * WHEEL_UNITS_PER_SECOND / SERVER_TICK_RATE;
+}
+
+static inline uint32_t SlotOf(uint32_t match_id)
+{
+    return match_id & ((1u << MATCH_ID_SHIFT) - 1);
+}
+
+static inline uint32_t GroupTimer(const Worker* worker, int group)
+{
+    return (uint32_t)(worker->capacity + group);
+}
+
+static inline uint32_t SweepTimer(const Worker* worker)
+{
+    return (uint32_t)(worker->capacity + TICK_GROUPS);
+}
+
+static int InitWorker(Worker* worker, unsigned int index, Worker* peers, unsigned int peer_count, Lobby* lobby, size_t capacity, const ServerOptions* options)
+{
+    memset(worker, 0, sizeof(*worker));
+    worker->socket = worker->timer = worker->epoll = -1;
+    worker->index = index;
+    worker->options = options;
+    worker->peers = peers;
+    worker->peer_count = peer_count;
+    worker->lobby = lobby;
+    worker->capacity = capacity;
+    worker->rng = MatchRng(options->seed, index);
+
+    worker->match_index = malloc(capacity * sizeof(uint32_t));
+    worker->match_group = malloc(capacity);
+    worker->free_slots = malloc(capacity * sizeof(uint32_t));
+    worker->snapshots = calloc(capacity, sizeof(SnapshotHistory));
+    worker->subscribers = calloc(capacity, sizeof(atomic_ullong));
+    worker->spectator_frames = calloc(capacity, sizeof(Snapshot));
+    worker->spectator_interval = SERVER_TICK_RATE / options->spectator_rate;
+    if (worker->spectator_interval == 0) worker->spectator_interval = 1;
+    pthread_mutex_init(&worker->inbox_lock, NULL);
+    pthread_mutex_init(&worker->mail_lock, NULL);
+    for (size_t i = 0; i < capacity; i++)
+    {
+        worker->match_index[i] = NO_MATCH;
+        worker->free_slots[i] = (uint32_t)(capacity - 1 - i);
+    }
+    worker->free_count = capacity;
+
+    // Groups start with an even share and grow if joins bunch up on one phase
+    worker->epoch = GetSeconds();
+    worker->wheel = CreateTimerWheel(capacity + TICK_GROUPS + 1, 0);
+    size_t group_capacity = capacity / TICK_GROUPS + 1;
+    for (int g = 0; g < TICK_GROUPS; g++)
+    {
+        TickGroup* group = &worker->groups[g];
+        group->batch = CreateGameBatch(group_capacity);
+        group->matches = malloc(group_capacity * sizeof(MatchInfo));
+        group->inputs = calloc(group_capacity, sizeof(GameInput));
+        group->start = (uint64_t)g * WHEEL_UNITS_PER_SECOND / (SERVER_TICK_RATE * TICK_GROUPS);
+        group->ticks = 1;
+        ScheduleTimer(&worker->wheel, GroupTimer(worker, g), GroupDue(group, group->ticks));
+    }
+    ScheduleTimer(&worker->wheel, SweepTimer(worker), WheelTime(worker, worker->epoch + SPECTATOR_KEEPALIVE));
+
+    worker->socket = OpenSharedUdpSocket(options->port);
+    worker->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    worker->epoll = epoll_create1(0);
+    if (worker->socket < 0 || worker->timer < 0 || worker->epoll < 0) return 0;
+
+    struct itimerspec interval;
+    interval.it_interval.tv_sec = 0;
+    interval.it_interval.tv_nsec = WAKEUP_INTERVAL_NS;
+    interval.it_value = interval.it_interval;
+    if (timerfd_settime(worker->timer, 0, &interval, NULL) != 0) return 0;
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = worker->socket;
+    if (epoll_ctl(worker->epoll, EPOLL_CTL_ADD, worker->socket, &event) != 0) return 0;
+    event.data.fd = worker->timer;
+    if (epoll_ctl(worker->epoll, EPOLL_CTL_ADD, worker->timer, &event) != 0) return 0;
+    return 1;
+}
+
+static void FreeWorker(Worker* worker)
+{
+    if (worker->epoll >= 0) close(worker->epoll);
+    if (worker->timer >= 0) close(worker->timer);
+    if (worker->socket >= 0) CloseUdpSocket(worker->socket);
+    for (int g = 0; g < TICK_GROUPS; g++)
+    {
+        DestroyGameBatch(&worker->groups[g].batch);
+        free(worker->groups[g].matches);
+        free(worker->groups[g].inputs);
+    }
+    DestroyTimerWheel(&worker->wheel);
+    free(worker->match_index);
+    free(worker->match_group);
+    free(worker->free_slots);
+    free(worker->snapshots);
+    free(worker->subscribers);
+    free(worker->spectator_frames);
+    for (size_t w = 0; w < worker->watch_count; w++)
+    {
+        free(worker->watches[w].addresses);
+        free(worker->watches[w].last_seen);
+    }
+    free(worker->watches);
+    for (size_t f = 0; f < worker->inbox_count; f++)
+    {
+        ReleaseSharedPacket(worker->inbox[f].packet);
+    }
+    free(worker->inbox);
+    free(worker->delivering);
+    pthread_mutex_destroy(&worker->inbox_lock);
+    free(worker->mail);
+    free(worker->reading);
+    pthread_mutex_destroy(&worker->mail_lock);
+}
+
+static void GrowGroup(TickGroup* group, size_t capacity)
+{
+    GameBatch batch = CreateGameBatch(capacity);
+    for (size_t i = 0; i < group->batch.count; i++)
+    {
+        GameBatchAdd(&batch, GameBatchGet(&group->batch, i));
+    }
+    DestroyGameBatch(&group->batch);
+    group->batch = batch;
+    group->matches = realloc(group->matches, capacity * sizeof(MatchInfo));
+    group->inputs = realloc(group->inputs, capacity * sizeof(GameInput));
+}
+
+static GameState NewMatchState(Worker* worker)
+{
+    uint64_t seed = (uint64_t)RngNext(&worker->rng) << 32 | RngNext(&worker->rng);
+    return InitGameState(SeedRng(seed));
+}
+
+// The group that ticks next, so a new match starts within a millisecond
+static int NextGroup(const Worker* worker)
+{
+    int best = 0;
+    for (int g = 1; g < TICK_GROUPS; g++)
+    {
+        const TickGroup* group = &worker->groups[g];
+        if (GroupDue(group, group->ticks) < GroupDue(&worker->groups[best], worker->groups[best].ticks)) best = g;
+    }
+    return best;
+}
+
+static void PushSpectatorFrame(Worker* worker, uint32_t match_id, int finished, SharedPacket* packet)
+{
+    pthread_mutex_lock(&worker->inbox_lock);
+    if (worker->inbox_count == worker->inbox_capacity) {
+        worker->inbox_capacity = worker->inbox_capacity ? worker->inbox_capacity * 2 : 64;
+        worker->inbox = realloc(worker->inbox, worker->inbox_capacity * sizeof(SpectatorFrame));
+    }
+    worker->inbox[worker->inbox_count++] = (SpectatorFrame){match_id, finished, packet};
+    pthread_mutex_unlock(&worker->inbox_lock);
+}
+
+// Encodes the match's state once and hands it to every worker watching it
+static void PublishSpectatorFrame(Worker* worker, uint32_t slot, unsigned char flags)
+{
+    uint64_t subscribers = atomic_load_explicit(&worker->subscribers[slot], memory_order_relaxed);
+    if (subscribers == 0) return;
+
+    const TickGroup* group = &worker->groups[worker->match_group[slot]];
+    uint32_t index = worker->match_index[slot];
+    const MatchInfo* match = &group->matches[index];
+    GameState state = GameBatchGet(&group->batch, index);
+    Snapshot frame = QuantizeGameState(&state, match->tick);
+
+    // A full snapshot on the first frame of each second
+    Snapshot* previous = &worker->spectator_frames[slot];
+    int delta = previous->tick != 0 && previous->tick < frame.tick && previous->tick / SERVER_TICK_RATE == frame.tick / SERVER_TICK_RATE;
+    StateMessage message;
+    message.match_id = match->id;
+    message.paddle = SPECTATOR_PADDLE;
+    message.flags = flags;
+    message.tick = frame.tick;
+    message.snapshot_size = EncodeSnapshot(&frame, delta ? previous : NULL, message.snapshot, sizeof(message.snapshot));
+    *previous = frame;
+
+    unsigned char packet[PROTOCOL_MAX_MESSAGE];
+    size_t size = WriteStateMessage(packet, &message);
+    SharedPacket* shared = CreateSharedPacket(packet, size, (unsigned int)__builtin_popcountll(subscribers));
+    if (shared == NULL) return;
+    for (unsigned int w = 0; w < worker->peer_count; w++)
+    {
+        if (subscribers >> w & 1) PushSpectatorFrame(&worker->peers[w], match->id, flags & STATE_FINISHED, shared);
+    }
+    atomic_fetch_add_explicit(&worker->stats.spectator_frames, 1, memory_order_relaxed);
+}
+
+// Returns the new match's slot, or NO_MATCH if the worker is full
+static uint32_t AddMatch(Worker* worker, int g, int bot, const ServerPlayer* players)
+{
+    if (worker->free_count == 0) return NO_MATCH;
+
+    TickGroup* group = &worker->groups[g];
+    if (group->batch.count == group->batch.capacity) {
+        size_t capacity = group->batch.capacity * 2;
+        GrowGroup(group, capacity < worker->capacity ? capacity : worker->capacity);
+    }
+
+    uint32_t slot = worker->free_slots[--worker->free_count];
+    uint32_t index = (uint32_t)GameBatchAdd(&group->batch, NewMatchState(worker));
+    worker->match_index[slot] = index;
+    worker->match_group[slot] = (unsigned char)g;
+
+    MatchInfo* match = &group->matches[index];
+    memset(match, 0, sizeof(*match));
+    match->id = worker->index << MATCH_ID_SHIFT | slot;
+    match->bot = bot;
+    worker->spectator_frames[slot].tick = 0;
+    worker->match_count++;
+    if (bot) {
+        group->bot_count++;
+        worker->bot_count++;
+    } else {
+        match->players[0] = players[0];
+        match->players[1] = players[1];
+        InitSnapshotHistory(&worker->snapshots[slot]);
+        ScheduleTimer(&worker->wheel, slot, WheelTime(worker, worker->now + PLAYER_TIMEOUT));
+    }
+    return slot;
+}
+
+static void RemoveMatch(Worker* worker, uint32_t slot)
+{
+    PublishSpectatorFrame(worker, slot, STATE_FINISHED);
+    TickGroup* group = &worker->groups[worker->match_group[slot]];
+    uint32_t index = worker->match_index[slot];
+    if (group->matches[index].bot) {
+        group->bot_count--;
+        worker->bot_count--;
+    }
+    worker->match_count--;
+    worker->match_index[slot] = NO_MATCH;
+    worker->free_slots[worker->free_count++] = slot;
+    CancelTimer(&worker->wheel, slot);
+
+    // GameBatchRemove moves the last match into index; the metadata follows
+    uint32_t last = (uint32_t)group->batch.count - 1;
+    GameBatchRemove(&group->batch, index);
+    if (index != last) {
+        group->matches[index] = group->matches[last];
+        worker->match_index[SlotOf(group->matches[index].id)] = index;
+    }
+}
+
+static MatchInfo* GetMatch(Worker* worker, uint32_t slot)
+{
+    return &worker->groups[worker->match_group[slot]].matches[worker->match_index[slot]];
+}
+
+// Slot of a match from a client packet, after checking the sender
+static uint32_t FindMatch(Worker* worker, uint32_t match_id, unsigned char paddle, const NetAddress* from)
+{
+    uint32_t slot = SlotOf(match_id);
+    if (match_id >> MATCH_ID_SHIFT != worker->index || slot >= worker->capacity || paddle > 1) return NO_MATCH;
+    if (worker->match_index[slot] == NO_MATCH) return NO_MATCH;
+
+    const MatchInfo* match = GetMatch(worker, slot);
+    if (match->bot || !SameAddress(&match->players[paddle].address, from)) return NO_MATCH;
+    return slot;
+}
+
+static inline uint64_t AddressKey(const NetAddress* address)
+{
+    return (uint64_t)address->host << 16 | address->port;
+}
+
+// First watch list whose match id is not below match_id
+static size_t WatchPosition(const Worker* worker, uint32_t match_id)
+{
+    size_t low = 0, high = worker->watch_count;
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (worker->watches[middle].match_id < match_id) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static WatchList* FindWatch(Worker* worker, uint32_t match_id)
+{
+    size_t w = WatchPosition(worker, match_id);
+    return w < worker->watch_count && worker->watches[w].match_id == match_id ? &worker->watches[w] : NULL;
+}
+
+// First position in the list whose address is not below address
+static size_t LowerBound(const WatchList* watch, const NetAddress* address)
+{
+    uint64_t key = AddressKey(address);
+    size_t low = 0, high = watch->count;
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (AddressKey(&watch->addresses[middle]) < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static void DropWatch(Worker* worker, WatchList* watch)
+{
+    uint32_t match_id = watch->match_id;
+    Worker* owner = &worker->peers[match_id >> MATCH_ID_SHIFT];
+    atomic_fetch_and_explicit(&owner->subscribers[SlotOf(match_id)], ~(1ull << worker->index), memory_order_relaxed);
+    worker->spectator_count -= watch->count;
+    free(watch->addresses);
+    free(watch->last_seen);
+    size_t w = (size_t)(watch - worker->watches);
+    memmove(watch, watch + 1, (--worker->watch_count - w) * sizeof(WatchList));
+}
+
+static void Watch(Worker* worker, uint32_t match_id, const NetAddress* from)
+{
+    unsigned int owner = match_id >> MATCH_ID_SHIFT;
+    if (owner >= worker->peer_count || SlotOf(match_id) >= worker->peers[owner].capacity) return;
+
+    WatchList* watch = FindWatch(worker, match_id);
+    size_t position = watch != NULL ? LowerBound(watch, from) : 0;
+    if (watch != NULL && position < watch->count && SameAddress(&watch->addresses[position], from)) {
+        watch->last_seen[position] = worker->now;
+        return;
+    }
+    if (worker->spectator_count >= worker->options->max_spectators) return;
+
+    if (watch == NULL) {
+        if (worker->watch_count == worker->watch_capacity) {
+            worker->watch_capacity = worker->watch_capacity ? worker->watch_capacity * 2 : 16;
+            worker->watches = realloc(worker->watches, worker->watch_capacity * sizeof(WatchList));
+        }
+        size_t w = WatchPosition(worker, match_id);
+        memmove(&worker->watches[w + 1], &worker->watches[w], (worker->watch_count++ - w) * sizeof(WatchList));
+        watch = &worker->watches[w];
+        memset(watch, 0, sizeof(*watch));
+        watch->match_id = match_id;
+        atomic_fetch_or_explicit(&worker->peers[owner].subscribers[SlotOf(match_id)], 1ull << worker->index, memory_order_relaxed);
+    }
+    if (watch->count == watch->capacity) {
+        watch->capacity = watch->capacity ? watch->capacity * 2 : 16;
+        watch->addresses = realloc(watch->addresses, watch->capacity * sizeof(NetAddress));
+        watch->last_seen = realloc(watch->last_seen, watch->capacity * sizeof(double));
+    }
+    memmove(&watch->addresses[position + 1], &watch->addresses[position], (watch->count - position) * sizeof(NetAddress));
+    memmove(&watch->last_seen[position + 1], &watch->last_seen[position], (watch->count - position) * sizeof(double));
+    watch->addresses[position] = *from;
+    watch->last_seen[position] = worker->now;
+    watch->count++;
+    worker->spectator_count++;
+}
+
+// Drops spectators that stopped resending MSG_WATCH
+static void SweepSpectators(Worker* worker)
+{
+    for (size_t w = worker->watch_count; w-- > 0;)
+    {
+        WatchList* watch = &worker->watches[w];
+        size_t kept = 0;
+        for (size_t i = 0; i < watch->count; i++)
+        {
+            if (worker->now - watch->last_seen[i] > PLAYER_TIMEOUT) continue;
+            watch->addresses[kept] = watch->addresses[i];
+            watch->last_seen[kept] = watch->last_seen[i];
+            kept++;
+        }
+        worker->spectator_count -= watch->count - kept;
+        watch->count = kept;
+        if (kept == 0) DropWatch(worker, watch);
+    }
+}
+
+static void DeliverSpectatorFrames(Worker* worker)
+{
+    pthread_mutex_lock(&worker->inbox_lock);
+    SpectatorFrame* frames = worker->inbox;
+    size_t count = worker->inbox_count;
+    size_t capacity = worker->inbox_capacity;
+    worker->inbox = worker->delivering;
+    worker->inbox_capacity = worker->delivering_capacity;
+    worker->inbox_count = 0;
+    pthread_mutex_unlock(&worker->inbox_lock);
+    worker->delivering = frames;
+    worker->delivering_capacity = capacity;
+
+    unsigned long sent = 0;
+    for (size_t f = 0; f < count; f++)
+    {
+        SpectatorFrame* frame = &frames[f];
+        WatchList* watch = FindWatch(worker, frame->match_id);
+        if (watch != NULL) {
+            sent += SendPacketToMany(worker->socket, watch->addresses, watch->count, frame->packet->data, frame->packet->size);
+            if (frame->finished) DropWatch(worker, watch);
+        }
+        ReleaseSharedPacket(frame->packet);
+    }
+    atomic_fetch_add_explicit(&worker->stats.spectator_packets, sent, memory_order_relaxed);
+}
+
+static void SendState(Worker* worker, uint32_t slot, unsigned char flags)
+{
+    const TickGroup* group = &worker->groups[worker->match_group[slot]];
+    const MatchInfo* match = GetMatch(worker, slot);
+    GameState state = GameBatchGet(&group->batch, worker->match_index[slot]);
+    Snapshot snapshot = QuantizeGameState(&state, match->tick);
+    SnapshotHistory* history = &worker->snapshots[slot];
+    StoreSnapshot(history, &snapshot);
+
+    StateMessage message;
+    message.match_id = match->id;
+    message.flags = flags;
+    message.tick = match->tick;
+
+    unsigned char packet[PROTOCOL_MAX_MESSAGE];
+    for (int p = 0; p < 2; p++)
+    {
+        // Full snapshot until the player acknowledges one still in the history
+        const ServerPlayer* player = &match->players[p];
+        const Snapshot* baseline = player->ack != 0 && player->ack < match->tick ? FindSnapshot(history, player->ack) : NULL;
+        message.paddle = (unsigned char)p;
+        message.snapshot_size = EncodeSnapshot(&snapshot, baseline, message.snapshot, sizeof(message.snapshot));
+        size_t size = WriteStateMessage(packet, &message);
+        SendPacket(worker->socket, &player->address, packet, size);
+    }
+    atomic_fetch_add_explicit(&worker->stats.packets_out, 2, memory_order_relaxed);
+}
+
+static void PostMail(Worker* worker, const WorkerMail* mail)
+{
+    pthread_mutex_lock(&worker->mail_lock);
+    if (worker->mail_count == worker->mail_capacity) {
+        worker->mail_capacity = worker->mail_capacity ? worker->mail_capacity * 2 : 64;
+        worker->mail = realloc(worker->mail, worker->mail_capacity * sizeof(WorkerMail));
+    }
+    worker->mail[worker->mail_count++] = *mail;
+    pthread_mutex_unlock(&worker->mail_lock);
+}
+
+// Hands a packet of another worker's match to that worker; returns 0 if the
+// match id is this worker's own
+static int ForwardPacket(Worker* worker, uint32_t match_id, const NetAddress* from, const unsigned char* data, size_t size)
+{
+    unsigned int owner = match_id >> MATCH_ID_SHIFT;
+    if (owner == worker->index) return 0;
+    if (owner < worker->peer_count && size <= PROTOCOL_MAX_MESSAGE) {
+        WorkerMail mail;
+        mail.from = *from;
+        mail.size = size;
+        memcpy(mail.data, data, size);
+        PostMail(&worker->peers[owner], &mail);
+    }
+    return 1;
+}
+
+// Pairs the player with the one waiting in the lobby, or leaves it waiting;
+// the match starts on the worker of the player who waited
+static void JoinLobby(Worker* worker, const ServerPlayer* player)
+{
+    Lobby* lobby = worker->lobby;
+    WorkerMail mail;
+    unsigned int owner = 0;
+    int paired = 0;
+    pthread_mutex_lock(&lobby->lock);
+    if (lobby->has_waiting && SameAddress(&lobby->waiting.address, &player->address)) {
+        lobby->waiting.last_seen = player->last_seen;
+    } else if (lobby->has_waiting && player->last_seen - lobby->waiting.last_seen <= PLAYER_TIMEOUT) {
+        mail.players[0] = lobby->waiting;
+        mail.players[1] = *player;
+        owner = lobby->worker;
+        lobby->has_waiting = 0;
+        paired = 1;
+    } else {
+        lobby->waiting = *player;
+        lobby->worker = worker->index;
+        lobby->has_waiting = 1;
+    }
+    pthread_mutex_unlock(&lobby->lock);
+
+    // A full worker drops the pair; both keep sending MSG_JOIN and queue again
+    if (!paired) return;
+    if (owner == worker->index) {
+        AddMatch(worker, NextGroup(worker), 0, mail.players);
+    } else {
+        mail.size = 0;
+        PostMail(&worker->peers[owner], &mail);
+    }
+}
+
+static void HandlePacket(Worker* worker, const NetAddress* from, const unsigned char* data, size_t size)
+{
+    MessageType type;
+    if (!ReadMessageType(data, size, &type)) return;
+    double now = worker->now;
+
+    if (type == MSG_JOIN) {
+        ServerPlayer player = {*from, now, 0, 0};
+        JoinLobby(worker, &player);
+    } else if (type == MSG_INPUT) {
+        InputMessage message;
+        if (!ReadInputMessage(data, size, &message) || ForwardPacket(worker, message.match_id, from, data, size)) return;
+        uint32_t slot = FindMatch(worker, message.match_id, message.paddle, from);
+        if (slot == NO_MATCH) return;
+        ServerPlayer* player = &GetMatch(worker, slot)->players[message.paddle];
+        player->buttons = message.buttons & (INPUT_UP | INPUT_DOWN);
+        player->last_seen = now;
+        // Inputs may arrive out of order; only move the baseline forward
+        if (message.ack > player->ack && message.ack <= GetMatch(worker, slot)->tick) player->ack = message.ack;
+    } else if (type == MSG_LEAVE) {
+        uint32_t match_id;
+        unsigned char paddle;
+        if (!ReadLeaveMessage(data, size, &match_id, &paddle) || ForwardPacket(worker, match_id, from, data, size)) return;
+        uint32_t slot = FindMatch(worker, match_id, paddle, from);
+        if (slot == NO_MATCH) return;
+        SendState(worker, slot, STATE_FINISHED);
+        RemoveMatch(worker, slot);
+    } else if (type == MSG_PING) {
+        // Time since the tick was due rather than since it ran, so clients
+        // see the schedule, not how late this worker's wakeups are
+        PingMessage ping;
+        if (!ReadPingMessage(data, size, &ping) || ForwardPacket(worker, ping.match_id, from, data, size)) return;
+        uint32_t slot = FindMatch(worker, ping.match_id, ping.paddle, from);
+        if (slot == NO_MATCH) return;
+        const TickGroup* group = &worker->groups[worker->match_group[slot]];
+        double since = now - group->stepped_due;
+        PongMessage pong = {ping.client_time, GetMatch(worker, slot)->tick, since > 0.0 ? (uint32_t)(since * 1e6) : 0};
+        unsigned char packet[PROTOCOL_MAX_MESSAGE];
+        SendPacket(worker->socket, from, packet, WritePongMessage(packet, &pong));
+        atomic_fetch_add_explicit(&worker->stats.packets_out, 1, memory_order_relaxed);
+    } else if (type == MSG_WATCH) {
+        uint32_t match_id;
+        if (ReadWatchMessage(data, size, &match_id)) Watch(worker, match_id, from);
+    }
+}
+
+static void DrainSocket(Worker* worker)
+{
+    unsigned char packet[NET_MAX_PACKET];
+    NetAddress from;
+    int size;
+    while ((size = ReceivePacket(worker->socket, &from, packet, sizeof(packet))) > 0)
+    {
+        atomic_fetch_add_explicit(&worker->stats.packets_in, 1, memory_order_relaxed);
+        HandlePacket(worker, &from, packet, (size_t)size);
+    }
+}
+
+static void ReadMail(Worker* worker)
+{
+    pthread_mutex_lock(&worker->mail_lock);
+    WorkerMail* mail = worker->mail;
+    size_t count = worker->mail_count;
+    size_t capacity = worker->mail_capacity;
+    worker->mail = worker->reading;
+    worker->mail_capacity = worker->reading_capacity;
+    worker->mail_count = 0;
+    pthread_mutex_unlock(&worker->mail_lock);
+    worker->reading = mail;
+    worker->reading_capacity = capacity;
+
+    for (size_t m = 0; m < count; m++)
+    {
+        if (mail[m].size == 0) {
+            AddMatch(worker, NextGroup(worker), 0, mail[m].players);
+        } else {
+            HandlePacket(worker, &mail[m].from, mail[m].data, mail[m].size);
+        }
+    }
+}
+
+static void TickGroupMatches(Worker* worker, TickGroup* group)
+{
+    GameBatch* batch = &group->batch;
+    if (group->bot_count > 0) AiPolicy(batch, group->inputs, NULL);
+    for (size_t i = 0; i < batch->count; i++)
+    {
+        if (group->matches[i].bot) continue;
+        group->inputs[i].paddles[0] = group->matches[i].players[0].buttons;
+        group->inputs[i].paddles[1] = group->matches[i].players[1].buttons;
+    }
+
+    size_t stepped = batch->count;
+    StepGameBatch(batch, group->inputs);
+
+    // Backwards, so a removal only moves an already handled match into i
+    for (size_t i = batch->count; i-- > 0;)
+    {
+        MatchInfo* match = &group->matches[i];
+        match->tick++;
+        unsigned int points = worker->options->points;
+        int finished = batch->score[0][i] >= points || batch->score[1][i] >= points;
+        uint32_t slot = SlotOf(match->id);
+        // A finished player match sends its last frame from RemoveMatch
+        if (match->tick % worker->spectator_interval == 0 && (!finished || match->bot)) PublishSpectatorFrame(worker, slot, 0);
+
+        if (match->bot) {
+            if (finished) {
+                GameBatchSet(batch, i, NewMatchState(worker));
+                match->tick = 0;
+                worker->spectator_frames[slot].tick = 0;
+            }
+            continue;
+        }
+
+        SendState(worker, slot, finished ? STATE_FINISHED : 0);
+        if (finished) RemoveMatch(worker, slot);
+    }
+
+    atomic_fetch_add_explicit(&worker->stats.ticks, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&worker->stats.match_ticks, stepped, memory_order_relaxed);
+}
+
+static void OnTimer(TimerWheel* wheel, uint32_t timer, uint64_t due, void* user)
+{
+    Worker* worker = (Worker*)user;
+    double now = worker->now;
+
+    if (timer < worker->capacity) {
+        // Checked lazily: inputs only refresh last_seen, and the timer
+        // re-arms for the quieter player when it fires
+        MatchInfo* match = GetMatch(worker, timer);
+        double last_seen = match->players[0].last_seen < match->players[1].last_seen ? match->players[0].last_seen : match->players[1].last_seen;
+        if (now - last_seen > PLAYER_TIMEOUT) {
+            SendState(worker, timer, STATE_FINISHED);
+            RemoveMatch(worker, timer);
+        } else {
+            ScheduleTimer(wheel, timer, WheelTime(worker, last_seen + PLAYER_TIMEOUT) + 1);
+        }
+    } else if (timer == SweepTimer(worker)) {
+        SweepSpectators(worker);
+        ScheduleTimer(wheel, timer, due + (uint64_t)(SPECTATOR_KEEPALIVE * WHEEL_UNITS_PER_SECOND));
+    } else {
+        TickGroup* group = &worker->groups[timer - worker->capacity];
+        double lateness = now - (worker->epoch + (double)due / WHEEL_UNITS_PER_SECOND);
+        RecordLateness(&worker->lateness, lateness > 0.0 ? lateness : 0.0);
+        if (lateness > LATE_TICK) atomic_fetch_add_explicit(&worker->stats.late, 1, memory_order_relaxed);
+
+        group->stepped_due = worker->epoch + (double)due / WHEEL_UNITS_PER_SECOND;
+        double start = GetSeconds();
+        TickGroupMatches(worker, group);
+        atomic_fetch_add_explicit(&worker->stats.tick_ns, (uint64_t)((GetSeconds() - start) * 1e9), memory_order_relaxed);
+        group->ticks++;
+
+        // Far behind (a stall, or a suspended process): drop ticks rather
+        // than run a long burst
+        uint64_t behind = MAX_CATCH_UP * WHEEL_UNITS_PER_SECOND / SERVER_TICK_RATE;
+        while (GroupDue(group, group->ticks) + behind < WheelTime(worker, now))
+        {
+            group->ticks++;
+            atomic_fetch_add_explicit(&worker->stats.skipped, 1, memory_order_relaxed);
+        }
+        ScheduleTimer(wheel, timer, GroupDue(group, group->ticks));
+    }
+}
+
+static void PublishStats(Worker* worker)
+{
+    WorkerStats* stats = &worker->stats;
+    atomic_store_explicit(&stats->matches, worker->match_count, memory_order_relaxed);
+    atomic_store_explicit(&stats->bots, worker->bot_count, memory_order_relaxed);
+    atomic_store_explicit(&stats->players, 2 * (worker->match_count - worker->bot_count), memory_order_relaxed);
+    atomic_store_explicit(&stats->spectators, worker->spectator_count, memory_order_relaxed);
+}
+
+static void* RunWorker(void* arg)
+{
+    Worker* worker = (Worker*)arg;
+    struct epoll_event events[2];
+
+    while (!atomic_load(&server_stop))
+    {
+        int count = epoll_wait(worker->epoll, events, 2, 100);
+        double start = GetSeconds();
+        worker->now = start;
+        for (int e = 0; e < count; e++)
+        {
+            if (events[e].data.fd == worker->socket) {
+                DrainSocket(worker);
+                continue;
+            }
+
+            uint64_t expirations = 0;
+            if (read(worker->timer, &expirations, sizeof(expirations)) != sizeof(expirations)) continue;
+            ReadMail(worker);
+            AdvanceTimerWheel(&worker->wheel, WheelTime(worker, start), OnTimer, worker);
+        }
+        DeliverSpectatorFrames(worker);
+        if (count > 0) {
+            PublishStats(worker);
+            uint64_t busy = (uint64_t)((GetSeconds() - start) * 1e9);
+            atomic_fetch_add_explicit(&worker->stats.busy_ns, busy, memory_order_relaxed);
+        }
+    }
+
+    return NULL;
+}
+
+static void Usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [-P port] [-j workers] [-m max_matches] [-b bot_matches]\n"
+                    "       [-p points] [-d seconds] [-s seed] [-r spectator_rate]\n"
+                    "       [-S max_spectators_per_worker]\n", name);
+}
+
+static int ParseOptions(int argc, char** argv, ServerOptions* options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc) {
+            Usage(argv[0]);
+            return 0;
+        }
+        const char* value = argv[++i];
+        if (strcmp(argv[i-1], "-P") == 0) {
+            options->port = (uint16_t)strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-j") == 0) {
+            options->workers = (unsigned int)strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-m") == 0) {
+            options->max_matches = strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-b") == 0) {
+            options->bots = strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-p") == 0) {
+            options->points = (unsigned int)strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-d") == 0) {
+            options->duration = strtod(value, NULL);
+        } else if (strcmp(argv[i-1], "-s") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-r") == 0) {
+            options->spectator_rate = (unsigned int)strtoul(value, NULL, 10);
+            if (options->spectator_rate == 0) options->spectator_rate = 1;
+        } else if (strcmp(argv[i-1], "-S") == 0) {
+            options->max_spectators = strtoul(value, NULL, 10);
+        } else {
+            Usage(argv[0]);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    ServerOptions options = {7777, 0, 16384, 0, 11, 0.0, 0, 20, 65536};
+    if (!ParseOptions(argc, argv, &options)) return 1;
+    if (options.workers == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        options.workers = cores > 0 ? (unsigned int)cores : 1;
+    }
+    if (options.workers > MAX_WORKERS) options.workers = MAX_WORKERS;
+    if (options.bots > options.max_matches) options.max_matches = options.bots;
+
+    size_t capacity = (options.max_matches + options.workers - 1) / options.workers;
+    if (capacity == 0) capacity = 1;
+    if (capacity > (1u << MATCH_ID_SHIFT)) {
+        fprintf(stderr, "Too many matches per worker: %zu\n", capacity);
+        return 1;
+    }
+
+    signal(SIGINT, StopServer);
+    signal(SIGTERM, StopServer);
+
+    Lobby lobby;
+    memset(&lobby, 0, sizeof(lobby));
+    pthread_mutex_init(&lobby.lock, NULL);
+    Worker* workers = calloc(options.workers, sizeof(Worker));
+    for (unsigned int w = 0; w < options.workers; w++)
+    {
+        if (!InitWorker(&workers[w], w, workers, options.workers, &lobby, capacity, &options)) {
+            fprintf(stderr, "Failed to set up worker %u on port %u\n", w, options.port);
+            return 1;
+        }
+    }
+    // Spread bots over every tick phase, as if they had joined at random times
+    for (unsigned long b = 0; b < options.bots; b++)
+    {
+        AddMatch(&workers[b % options.workers], (int)(b / options.workers % TICK_GROUPS), 1, NULL);
+    }
+    for (unsigned int w = 0; w < options.workers; w++)
+    {
+        PublishStats(&workers[w]);
+    }
+    for (unsigned int w = 0; w < options.workers; w++)
+    {
+        pthread_create(&workers[w].thread, NULL, RunWorker, &workers[w]);
+    }
+
+    printf("listening on port %u: %u workers, %zu matches each, %zu bytes per match slot\n",
+           options.port, options.workers, capacity, MatchSlotBytes());
+
+    double start = GetSeconds();
+    double last = start;
+    unsigned long long last_match_ticks = 0, last_busy_ns = 0, last_tick_ns = 0;
+    unsigned long last_spectator_frames = 0, last_spectator_packets = 0;
+    while (!atomic_load(&server_stop))
+    {
+        sleep(1);
+        double now = GetSeconds();
+
+        unsigned long matches = 0, bots = 0, players = 0, late = 0, skipped = 0;
+        unsigned long spectators = 0, spectator_frames = 0, spectator_packets = 0;
+        unsigned long long match_ticks = 0, busy_ns = 0, tick_ns = 0, max_busy_ns = 0;
+        for (unsigned int w = 0; w < options.workers; w++)
+        {
+            WorkerStats* stats = &workers[w].stats;
+            matches += atomic_load(&stats->matches);
+            bots += atomic_load(&stats->bots);
+            players += atomic_load(&stats->players);
+            late += atomic_load(&stats->late);
+            skipped += atomic_load(&stats->skipped);
+            spectators += atomic_load(&stats->spectators);
+            spectator_frames += atomic_load(&stats->spectator_frames);
+            spectator_packets += atomic_load(&stats->spectator_packets);
+            match_ticks += atomic_load(&stats->match_ticks);
+            tick_ns += atomic_load(&stats->tick_ns);
+            unsigned long long busy = atomic_load(&stats->busy_ns);
+            busy_ns += busy;
+            if (busy > max_busy_ns) max_busy_ns = busy;
+        }
+        pthread_mutex_lock(&lobby.lock);
+        players += lobby.has_waiting && now - lobby.waiting.last_seen <= PLAYER_TIMEOUT;
+        pthread_mutex_unlock(&lobby.lock);
+
+        double interval = now - last;
+        unsigned long long ticked = match_ticks - last_match_ticks;
+        printf("matches: %lu (%lu bots), players: %lu, match ticks/s: %.0f, cpu: %.1f%% of %u workers, %.2f us per match tick, late ticks: %lu, skipped: %lu\n",
+               matches, bots, players, ticked / interval, 100.0 * (busy_ns - last_busy_ns) * 1e-9 / (interval * options.workers),
+               options.workers, ticked > 0 ? (tick_ns - last_tick_ns) * 1e-3 / ticked : 0.0, late, skipped);
+        if (spectators > 0) {
+            printf("spectators: %lu, spectator frames/s: %.0f, spectator packets/s: %.0f\n", spectators,
+                   (spectator_frames - last_spectator_frames) / interval, (spectator_packets - last_spectator_packets) / interval);
+        }
+        fflush(stdout);
+        last_spectator_frames = spectator_frames;
+        last_spectator_packets = spectator_packets;
+        last = now;
+        last_match_ticks = match_ticks;
+        last_busy_ns = busy_ns;
+        last_tick_ns = tick_ns;
+
+        if (options.duration > 0.0 && now - start >= options.duration) break;
+    }
+
+    atomic_store(&server_stop, 1);
+    unsigned long packets_in = 0, packets_out = 0;
+    LatenessHistogram lateness;
+    memset(&lateness, 0, sizeof(lateness));
+    // Workers push spectator frames to each other, so none is freed before all have stopped
+    for (unsigned int w = 0; w < options.workers; w++)
+    {
+        pthread_join(workers[w].thread, NULL);
+    }
+    for (unsigned int w = 0; w < options.workers; w++)
+    {
+        packets_in += atomic_load(&workers[w].stats.packets_in);
+        packets_out += atomic_load(&workers[w].stats.packets_out);
+        MergeLatenessHistogram(&lateness, &workers[w].lateness);
+        FreeWorker(&workers[w]);
+    }
+    printf("packets: %lu in, %lu out\n", packets_in, packets_out);
+    PrintLatenessHistogram(&lateness, stdout);
+    free(workers);
+    pthread_mutex_destroy(&lobby.lock);
+    return 0;
+}
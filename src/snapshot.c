@@ -0,0 +1,304 @@
+#include "snapshot.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_PREDICTED_TICKS 64
+
+// Fields in wire order; positions are followed by the velocity predicting them
+enum {
+    FIELD_BALL_X, FIELD_BALL_Y, FIELD_BALL_VX, FIELD_BALL_VY,
+    FIELD_PADDLE0_Y, FIELD_PADDLE1_Y, FIELD_PADDLE0_VY, FIELD_PADDLE1_VY,
+    FIELD_SCORE0, FIELD_SCORE1,
+    FIELD_COUNT,
+};
+
+// MSB-first bit streams. The writer collects bits in a 64-bit word and
+// stores whole bytes; the reader refills a word a byte at a time.
+typedef struct BitWriter {
+    unsigned char* data;
+    size_t capacity;
+    size_t size;
+    uint64_t pending;
+    int pending_bits;
+    int overflow;
+} BitWriter;
+
+typedef struct BitReader {
+    const unsigned char* data;
+    size_t size;
+    size_t offset;
+    uint64_t pending;
+    int pending_bits;
+    int overflow;
+} BitReader;
+
+// count <= 32
+static void WriteBits(BitWriter* writer, uint32_t value, int count)
+{
+    if (count == 0) return;
+    writer->pending = writer->pending << count | (value & (uint32_t)(0xffffffffu >> (32 - count)));
+    writer->pending_bits += count;
+    while (writer->pending_bits >= 8)
+    {
+        writer->pending_bits -= 8;
+        if (writer->size == writer->capacity) {
+            writer->overflow = 1;
+            continue;
+        }
+        writer->data[writer->size++] = (unsigned char)(writer->pending >> writer->pending_bits);
+    }
+}
+
+static size_t FlushBits(BitWriter* writer)
+{
+    if (writer->pending_bits > 0) WriteBits(writer, 0, 8 - writer->pending_bits);
+    return writer->overflow ? 0 : writer->size;
+}
+
+// count <= 32
+static uint32_t ReadBits(BitReader* reader, int count)
+{
+    if (count == 0) return 0;
+    while (reader->pending_bits < count)
+    {
+        if (reader->offset == reader->size) {
+            reader->overflow = 1;
+            return 0;
+        }
+        reader->pending = reader->pending << 8 | reader->data[reader->offset++];
+        reader->pending_bits += 8;
+    }
+    reader->pending_bits -= count;
+    return (uint32_t)(reader->pending >> reader->pending_bits) & (uint32_t)(0xffffffffu >> (32 - count));
+}
+
+// Elias gamma code for value >= 1: n zeros, then value in n + 1 bits
+static void WriteGamma(BitWriter* writer, uint32_t value)
+{
+    int n = 0;
+    while ((value >> (n + 1)) != 0) n++;
+    WriteBits(writer, 0, n);
+    WriteBits(writer, value, n + 1);
+}
+
+static uint32_t ReadGamma(BitReader* reader)
+{
+    int n = 0;
+    while (n < 32 && ReadBits(reader, 1) == 0 && !reader->overflow) n++;
+    if (n >= 32 || reader->overflow) {
+        reader->overflow = 1;
+        return 0;
+    }
+    return (1u << n) | ReadBits(reader, n);
+}
+
+// Fields against their prediction: '0' for no change, else '1' and a 2-bit
+// class. Classes 0-2 hold the zigzagged residual in 3, 6 or 10 bits; class
+// 3 holds the field itself in 16 bits, as a residual can take up to 19
+#define RAW_CLASS 3
+static const int residual_width[RAW_CLASS] = {3, 6, 10};
+
+static void WriteField(BitWriter* writer, int32_t value, int32_t predicted)
+{
+    int32_t residual = value - predicted;
+    if (residual == 0) {
+        WriteBits(writer, 0, 1);
+        return;
+    }
+    uint32_t zigzag = ((uint32_t)residual << 1) ^ (uint32_t)(residual >> 31);
+    uint32_t code = zigzag - 1;
+    int width = 0;
+    while (width < RAW_CLASS && code >= 1u << residual_width[width]) width++;
+    WriteBits(writer, 1, 1);
+    WriteBits(writer, (uint32_t)width, 2);
+    if (width == RAW_CLASS) {
+        WriteBits(writer, (uint32_t)value & 0xffff, 16);
+    } else {
+        WriteBits(writer, code, residual_width[width]);
+    }
+}
+
+// Raw values come back sign-extended; the caller masks unsigned fields
+static int32_t ReadField(BitReader* reader, int32_t predicted)
+{
+    if (ReadBits(reader, 1) == 0) return predicted;
+    int width = (int)ReadBits(reader, 2);
+    if (width == RAW_CLASS) return (int16_t)ReadBits(reader, 16);
+    uint32_t zigzag = ReadBits(reader, residual_width[width]) + 1;
+    return predicted + ((int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1));
+}
+
+static int16_t Quantize(float value, int scale)
+{
+    float scaled = roundf(value * scale);
+    if (scaled > 32767.f) return 32767;
+    if (scaled < -32768.f) return -32768;
+    return (int16_t)scaled;
+}
+
+Snapshot QuantizeGameState(const GameState* state, uint32_t tick)
+{
+    Snapshot snapshot;
+    snapshot.tick = tick;
+    snapshot.ball_x = Quantize(state->ball.position.x, SNAPSHOT_POSITION_SCALE);
+    snapshot.ball_y = Quantize(state->ball.position.y, SNAPSHOT_POSITION_SCALE);
+    snapshot.ball_vx = Quantize(state->ball.velocity.x, SNAPSHOT_VELOCITY_SCALE);
+    snapshot.ball_vy = Quantize(state->ball.velocity.y, SNAPSHOT_VELOCITY_SCALE);
+    for (int p = 0; p < 2; p++)
+    {
+        snapshot.paddle_y[p] = Quantize(state->paddles[p].position.y, SNAPSHOT_POSITION_SCALE);
+        snapshot.paddle_vy[p] = Quantize(state->paddles[p].velocity.y, SNAPSHOT_VELOCITY_SCALE);
+        snapshot.score[p] = state->paddles[p].score > 65535 ? 65535 : (uint16_t)state->paddles[p].score;
+    }
+    return snapshot;
+}
+
+GameState DequantizeSnapshot(const Snapshot* snapshot)
+{
+    GameState state = InitGameState((Rng){0});
+    state.ball.position.x = (float)snapshot->ball_x / SNAPSHOT_POSITION_SCALE;
+    state.ball.position.y = (float)snapshot->ball_y / SNAPSHOT_POSITION_SCALE;
+    state.ball.velocity.x = (float)snapshot->ball_vx / SNAPSHOT_VELOCITY_SCALE;
+    state.ball.velocity.y = (float)snapshot->ball_vy / SNAPSHOT_VELOCITY_SCALE;
+    for (int p = 0; p < 2; p++)
+    {
+        state.paddles[p].position.y = (float)snapshot->paddle_y[p] / SNAPSHOT_POSITION_SCALE;
+        state.paddles[p].velocity.y = (float)snapshot->paddle_vy[p] / SNAPSHOT_VELOCITY_SCALE;
+        state.paddles[p].score = snapshot->score[p];
+        snprintf(state.paddles[p].score_string, sizeof(state.paddles[p].score_string), "Score: %u", state.paddles[p].score);
+    }
+    return state;
+}
+
+static void GetFields(const Snapshot* snapshot, int32_t* fields)
+{
+    fields[FIELD_BALL_X] = snapshot->ball_x;
+    fields[FIELD_BALL_Y] = snapshot->ball_y;
+    fields[FIELD_BALL_VX] = snapshot->ball_vx;
+    fields[FIELD_BALL_VY] = snapshot->ball_vy;
+    fields[FIELD_PADDLE0_Y] = snapshot->paddle_y[0];
+    fields[FIELD_PADDLE1_Y] = snapshot->paddle_y[1];
+    fields[FIELD_PADDLE0_VY] = snapshot->paddle_vy[0];
+    fields[FIELD_PADDLE1_VY] = snapshot->paddle_vy[1];
+    fields[FIELD_SCORE0] = snapshot->score[0];
+    fields[FIELD_SCORE1] = snapshot->score[1];
+}
+
+static void SetFields(Snapshot* snapshot, const int32_t* fields)
+{
+    snapshot->ball_x = (int16_t)fields[FIELD_BALL_X];
+    snapshot->ball_y = (int16_t)fields[FIELD_BALL_Y];
+    snapshot->ball_vx = (int16_t)fields[FIELD_BALL_VX];
+    snapshot->ball_vy = (int16_t)fields[FIELD_BALL_VY];
+    snapshot->paddle_y[0] = (int16_t)fields[FIELD_PADDLE0_Y];
+    snapshot->paddle_y[1] = (int16_t)fields[FIELD_PADDLE1_Y];
+    snapshot->paddle_vy[0] = (int16_t)fields[FIELD_PADDLE0_VY];
+    snapshot->paddle_vy[1] = (int16_t)fields[FIELD_PADDLE1_VY];
+    snapshot->score[0] = (uint16_t)fields[FIELD_SCORE0];
+    snapshot->score[1] = (uint16_t)fields[FIELD_SCORE1];
+}
+
+// What the receiver expects without being told: positions carried along by
+// the baseline velocity, everything else unchanged. Integer-only, so both
+// sides agree exactly.
+static int32_t Travel(int32_t velocity, int32_t ticks)
+{
+    int32_t ratio = SNAPSHOT_VELOCITY_SCALE / SNAPSHOT_POSITION_SCALE;
+    int32_t distance = velocity * ticks;
+    return distance >= 0 ? (distance + ratio / 2) / ratio : -((ratio / 2 - distance) / ratio);
+}
+
+static void PredictFields(const Snapshot* baseline, uint32_t distance, int32_t* fields)
+{
+    GetFields(baseline, fields);
+    int32_t ticks = distance < MAX_PREDICTED_TICKS ? (int32_t)distance : MAX_PREDICTED_TICKS;
+    fields[FIELD_BALL_X] += Travel(fields[FIELD_BALL_VX], ticks);
+    fields[FIELD_BALL_Y] += Travel(fields[FIELD_BALL_VY], ticks);
+    fields[FIELD_PADDLE0_Y] += Travel(fields[FIELD_PADDLE0_VY], ticks);
+    fields[FIELD_PADDLE1_Y] += Travel(fields[FIELD_PADDLE1_VY], ticks);
+}
+
+size_t EncodeSnapshot(const Snapshot* snapshot, const Snapshot* baseline, unsigned char* buffer, size_t capacity)
+{
+    BitWriter writer = {buffer, capacity, 0, 0, 0, 0};
+    int32_t fields[FIELD_COUNT];
+    GetFields(snapshot, fields);
+
+    if (baseline == NULL) {
+        WriteGamma(&writer, 1);
+        for (int f = 0; f < FIELD_COUNT; f++)
+        {
+            WriteBits(&writer, (uint32_t)fields[f] & 0xffff, 16);
+        }
+    } else {
+        uint32_t distance = snapshot->tick - baseline->tick;
+        int32_t predicted[FIELD_COUNT];
+        PredictFields(baseline, distance, predicted);
+        WriteGamma(&writer, distance + 1);
+        for (int f = 0; f < FIELD_COUNT; f++)
+        {
+            WriteField(&writer, fields[f], predicted[f]);
+        }
+    }
+
+    return FlushBits(&writer);
+}
+
+int ReadSnapshotBaseline(const unsigned char* data, size_t size, uint32_t* distance)
+{
+    BitReader reader = {data, size, 0, 0, 0, 0};
+    uint32_t code = ReadGamma(&reader);
+    if (reader.overflow) return 0;
+    *distance = code - 1;
+    return 1;
+}
+
+int DecodeSnapshot(const unsigned char* data, size_t size, uint32_t tick, const Snapshot* baseline, Snapshot* snapshot)
+{
+    BitReader reader = {data, size, 0, 0, 0, 0};
+    uint32_t distance = ReadGamma(&reader) - 1;
+    if (reader.overflow || (distance == 0) != (baseline == NULL)) return 0;
+
+    int32_t fields[FIELD_COUNT];
+    if (baseline == NULL) {
+        for (int f = 0; f < FIELD_COUNT; f++)
+        {
+            fields[f] = (int16_t)ReadBits(&reader, 16);
+        }
+    } else {
+        if (baseline->tick != tick - distance) return 0;
+        PredictFields(baseline, distance, fields);
+        for (int f = 0; f < FIELD_COUNT; f++)
+        {
+            fields[f] = ReadField(&reader, fields[f]);
+        }
+    }
+    if (reader.overflow) return 0;
+    // Scores are unsigned
+    fields[FIELD_SCORE0] &= 0xffff;
+    fields[FIELD_SCORE1] &= 0xffff;
+
+    snapshot->tick = tick;
+    SetFields(snapshot, fields);
+    return 1;
+}
+
+void InitSnapshotHistory(SnapshotHistory* history)
+{
+    memset(history->valid, 0, sizeof(history->valid));
+}
+
+void StoreSnapshot(SnapshotHistory* history, const Snapshot* snapshot)
+{
+    uint32_t slot = snapshot->tick & (SNAPSHOT_HISTORY - 1);
+    history->snapshots[slot] = *snapshot;
+    history->valid[slot] = 1;
+}
+
+const Snapshot* FindSnapshot(const SnapshotHistory* history, uint32_t tick)
+{
+    uint32_t slot = tick & (SNAPSHOT_HISTORY - 1);
+    if (!history->valid[slot] || history->snapshots[slot].tick != tick) return NULL;
+    return &history->snapshots[slot];
+}
@@ -0,0 +1,188 @@
+#include "timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TIMER_MASK (TIMER_SLOTS - 1)
+
+TimerWheel CreateTimerWheel(size_t capacity, uint64_t now)
+{
+    TimerWheel wheel;
+    wheel.now = now;
+    for (size_t i = 0; i < TIMER_LEVELS * TIMER_SLOTS; i++)
+    {
+        wheel.slots[i] = TIMER_NONE;
+    }
+    wheel.timers = malloc(capacity * sizeof(TimerEntry));
+    wheel.capacity = capacity;
+    for (size_t i = 0; i < capacity; i++)
+    {
+        wheel.timers[i].slot = TIMER_NONE;
+    }
+    return wheel;
+}
+
+void DestroyTimerWheel(TimerWheel* wheel)
+{
+    free(wheel->timers);
+    wheel->timers = NULL;
+    wheel->capacity = 0;
+}
+
+static void Unlink(TimerWheel* wheel, uint32_t timer)
+{
+    TimerEntry* entry = &wheel->timers[timer];
+    if (entry->prev != TIMER_NONE) {
+        wheel->timers[entry->prev].next = entry->next;
+    } else {
+        wheel->slots[entry->slot] = entry->next;
+    }
+    if (entry->next != TIMER_NONE) wheel->timers[entry->next].prev = entry->prev;
+    entry->slot = TIMER_NONE;
+}
+
+// Files a timer no earlier than the unit earliest: now + 1 when scheduling,
+// since the current slot has already fired, and now when cascading, since
+// AdvanceTimerWheel fires the current slot right after the cascade
+static void Link(TimerWheel* wheel, uint32_t timer, uint64_t earliest)
+{
+    TimerEntry* entry = &wheel->timers[timer];
+    uint64_t due = entry->due > earliest ? entry->due : earliest;
+    uint64_t delta = due - wheel->now;
+
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 && delta >= (uint64_t)1 << (TIMER_BITS * (level + 1)))
+    {
+        level++;
+    }
+    // Past the top level's reach: park in its furthest slot and re-file on cascade
+    uint64_t reach = (uint64_t)1 << (TIMER_BITS * TIMER_LEVELS);
+    if (delta >= reach) due = wheel->now + reach - 1;
+
+    uint32_t slot = level * TIMER_SLOTS + ((due >> (TIMER_BITS * level)) & TIMER_MASK);
+    entry->slot = slot;
+    entry->prev = TIMER_NONE;
+    entry->next = wheel->slots[slot];
+    if (entry->next != TIMER_NONE) wheel->timers[entry->next].prev = timer;
+    wheel->slots[slot] = timer;
+}
+
+void ScheduleTimer(TimerWheel* wheel, uint32_t timer, uint64_t due)
+{
+    if (wheel->timers[timer].slot != TIMER_NONE) Unlink(wheel, timer);
+    wheel->timers[timer].due = due;
+    Link(wheel, timer, wheel->now + 1);
+}
+
+void CancelTimer(TimerWheel* wheel, uint32_t timer)
+{
+    if (wheel->timers[timer].slot != TIMER_NONE) Unlink(wheel, timer);
+}
+
+int TimerPending(const TimerWheel* wheel, uint32_t timer)
+{
+    return wheel->timers[timer].slot != TIMER_NONE;
+}
+
+// Re-files every timer of a coarse slot one level down (or lower)
+static void Cascade(TimerWheel* wheel, int level)
+{
+    uint32_t slot = level * TIMER_SLOTS + ((wheel->now >> (TIMER_BITS * level)) & TIMER_MASK);
+    uint32_t timer = wheel->slots[slot];
+    wheel->slots[slot] = TIMER_NONE;
+    while (timer != TIMER_NONE)
+    {
+        uint32_t next = wheel->timers[timer].next;
+        Link(wheel, timer, wheel->now);
+        timer = next;
+    }
+}
+
+void AdvanceTimerWheel(TimerWheel* wheel, uint64_t now, TimerCallback callback, void* user)
+{
+    while (wheel->now < now)
+    {
+        wheel->now++;
+
+        // Crossing into a new window of a level pulls its slot down, top first
+        int top = 0;
+        while (top < TIMER_LEVELS - 1 && (wheel->now & (((uint64_t)1 << (TIMER_BITS * (top + 1))) - 1)) == 0)
+        {
+            top++;
+        }
+        for (int level = top; level > 0; level--)
+        {
+            Cascade(wheel, level);
+        }
+
+        // Pop one at a time: the callback may cancel timers of this slot
+        uint32_t* head = &wheel->slots[wheel->now & TIMER_MASK];
+        while (*head != TIMER_NONE)
+        {
+            uint32_t timer = *head;
+            Unlink(wheel, timer);
+            callback(wheel, timer, wheel->timers[timer].due, user);
+        }
+    }
+}
+
+// Bucket b holds lateness below 50 us * 2^b; the last one everything above
+void RecordLateness(LatenessHistogram* histogram, double seconds)
+{
+    int bucket = 0;
+    double bound = 50e-6;
+    while (bucket < LATENESS_BUCKETS - 1 && seconds >= bound)
+    {
+        bucket++;
+        bound *= 2.0;
+    }
+    histogram->counts[bucket]++;
+    histogram->total++;
+    histogram->sum += seconds;
+    if (seconds > histogram->max) histogram->max = seconds;
+}
+
+void MergeLatenessHistogram(LatenessHistogram* into, const LatenessHistogram* from)
+{
+    for (int b = 0; b < LATENESS_BUCKETS; b++)
+    {
+        into->counts[b] += from->counts[b];
+    }
+    into->total += from->total;
+    into->sum += from->sum;
+    if (from->max > into->max) into->max = from->max;
+}
+
+double LatenessPercentile(const LatenessHistogram* histogram, double p)
+{
+    unsigned long long rank = (unsigned long long)(p * histogram->total);
+    unsigned long long seen = 0;
+    double bound = 50e-6;
+    for (int b = 0; b < LATENESS_BUCKETS - 1; b++)
+    {
+        seen += histogram->counts[b];
+        if (seen > rank) return bound;
+        bound *= 2.0;
+    }
+    return histogram->max;
+}
+
+void PrintLatenessHistogram(const LatenessHistogram* histogram, FILE* file)
+{
+    if (histogram->total == 0) return;
+
+    fprintf(file, "tick lateness: avg %.3f ms, p50 < %.3f ms, p99 < %.3f ms, max %.3f ms\n",
+            1000.0 * histogram->sum / histogram->total, 1000.0 * LatenessPercentile(histogram, 0.5),
+            1000.0 * LatenessPercentile(histogram, 0.99), 1000.0 * histogram->max);
+    double bound = 50e-6;
+    for (int b = 0; b < LATENESS_BUCKETS; b++)
+    {
+        if (histogram->counts[b] > 0) {
+            if (b < LATENESS_BUCKETS - 1) {
+                fprintf(file, "  < %7.3f ms: %llu\n", 1000.0 * bound, histogram->counts[b]);
+            } else {
+                fprintf(file, "  >=%7.3f ms: %llu\n", 1000.0 * bound / 2.0, histogram->counts[b]);
+            }
+        }
+        bound *= 2.0;
+    }
+}
@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "rng.h"
+#include "timer.h"
+
+// Checks that timer wheel timers fire on their due unit. Timers are due
+// exactly on the level boundaries and around them, plus random ones that
+// reschedule themselves when they fire, and the wheel advances in uneven
+// steps; a timer a cascade re-files into the current slot must still fire
+// on its unit. Exits non-zero on any mismatch.
+
+typedef struct TimerCheck {
+    Rng rng;
+    uint64_t* fired;            // unit each timer last fired on
+    unsigned long long count;
+    unsigned long long late;
+} TimerCheck;
+
+static void CheckTimer(TimerWheel* wheel, uint32_t timer, uint64_t due, void* user)
+{
+    TimerCheck* check = user;
+    check->count++;
+    if (wheel->now != due) check->late++;
+    check->fired[timer] = wheel->now;
+    // Reschedule from here so the next due time is relative to a nonzero now
+    if (RngBounded(&check->rng, 4) != 0) ScheduleTimer(wheel, timer, due + 1 + RngBounded(&check->rng, 1u << 20));
+}
+
+static void Usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [-s seed] [-n random_timers]\n", name);
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t seed = 0;
+    size_t random_timers = 1024;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc) {
+            Usage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (strcmp(argv[i-1], "-s") == 0) {
+            seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i-1], "-n") == 0) {
+            random_timers = strtoul(value, NULL, 10);
+        } else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    size_t boundaries = 3 * (TIMER_LEVELS - 1);
+    size_t capacity = boundaries + random_timers;
+    TimerCheck check = {SeedRng(seed), calloc(capacity, sizeof(uint64_t)), 0, 0};
+    TimerWheel wheel = CreateTimerWheel(capacity, 0);
+    if (check.fired == NULL || wheel.timers == NULL) {
+        fprintf(stderr, "Failed to allocate %zu timers\n", capacity);
+        return 1;
+    }
+
+    // One unit before, on and after each level's first boundary
+    uint64_t end = 0;
+    for (int level = 1; level < TIMER_LEVELS; level++)
+    {
+        uint64_t boundary = (uint64_t)1 << (TIMER_BITS * level);
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            uint32_t timer = (uint32_t)(level - 1) * 3 + k;
+            ScheduleTimer(&wheel, timer, boundary - 1 + k);
+        }
+        end = boundary + 1;
+    }
+    for (size_t t = boundaries; t < capacity; t++)
+    {
+        ScheduleTimer(&wheel, (uint32_t)t, 1 + RngBounded(&check.rng, 1u << 20));
+    }
+
+    end += 1u << 21;
+    while (wheel.now < end)
+    {
+        uint64_t step = 1 + RngBounded(&check.rng, 4096);
+        AdvanceTimerWheel(&wheel, wheel.now + step < end ? wheel.now + step : end, CheckTimer, &check);
+    }
+    // The boundary timers must have fired (on time, checked above) at least once
+    for (size_t t = 0; t < boundaries; t++)
+    {
+        if (check.fired[t] == 0) check.late++;
+    }
+
+    printf("units: %llu\n", (unsigned long long)wheel.now);
+    printf("timers fired: %llu\n", check.count);
+    printf("mismatches: %llu\n", check.late);
+    DestroyTimerWheel(&wheel);
+    free(check.fired);
+    return check.late == 0 ? 0 : 1;
+}
@@ -17,3 +17,36 @@ unsigned char* ReadFile(const char* path)
     fclose(fp);
     return buf;
 }
+
+int DecodeUtf8(const char** text)
+{
+    const unsigned char* s = (const unsigned char*)*text;
+    int length, codepoint, min;
+    if (s[0] < 0x80) {
+        *text += 1;
+        return s[0];
+    } else if ((s[0] & 0xe0) == 0xc0) {
+        length = 2, codepoint = s[0] & 0x1f, min = 0x80;
+    } else if ((s[0] & 0xf0) == 0xe0) {
+        length = 3, codepoint = s[0] & 0x0f, min = 0x800;
+    } else if ((s[0] & 0xf8) == 0xf0) {
+        length = 4, codepoint = s[0] & 0x07, min = 0x10000;
+    } else {
+        *text += 1;
+        return 0xfffd;
+    }
+
+    for (int i = 1; i < length; i++)
+    {
+        // Also stops at the terminator, which is no continuation byte
+        if ((s[i] & 0xc0) != 0x80) {
+            *text += 1;
+            return 0xfffd;
+        }
+        codepoint = (codepoint << 6) | (s[i] & 0x3f);
+    }
+    *text += length;
+    // Overlong forms, surrogates and values past Unicode
+    if (codepoint < min || (codepoint >= 0xd800 && codepoint <= 0xdfff) || codepoint > 0x10ffff) return 0xfffd;
+    return codepoint;
+}